@@ -41,6 +41,16 @@
 #define HAVE_IN_ADDR_T 1
 #endif
 
+#if defined(__linux__) && !defined(ANDROID) && !defined(__ANDROID__)
+/* Define to 1 if you have the `fmemopen' function. */
+#define HAVE_FMEMOPEN 1
+#endif
+
+#if defined(__linux__) || defined(__APPLE__)
+/* Define to 1 if you have the `mmap' function. */
+#define HAVE_MMAP 1
+#endif
+
 #if defined(N3DS)
    #error "This platform is not currently supported."
 #endif
@@ -10,6 +10,9 @@
 #include "machine.h"
 #include "maincpu.h"
 #include "snapshot.h"
+#include "snapshot_rewind.h"
+#include "profiler.h"
+#include "memfile.h"
 #include "autostart.h"
 #include "util.h"
 #include "crt.h"
@@ -36,6 +39,7 @@
 #include "sid.h"
 #include "sid-resources.h"
 #include "uistatusbar.h"
+#include "video-render.h"
 #if !defined(__XCBM5x0__)
 #include "userport.h"
 #endif
@@ -50,6 +54,9 @@ long retro_now = 0;
 unsigned retro_renderloop = 1;
 bool retro_sound_keep_alive = false;
 
+/* Frontend discards the video of the current frame */
+bool retro_video_hidden = false;
+
 /* VKBD */
 extern bool retro_vkbd;
 extern void print_vkbd(void);
@@ -73,6 +80,8 @@ struct vice_raster_s vice_raster;
 static snapshot_stream_t* snapshot_stream = NULL;
 static int load_trap_happened = 0;
 static int save_trap_happened = 0;
+static size_t snapshot_size_cached = 0;
+static bool snapshot_size_dirty = true;
 
 unsigned int retro_devices[RETRO_DEVICES] = {0};
 unsigned int opt_video_options_display = 0;
@@ -120,7 +129,14 @@ unsigned int retroYS_offset = 0;
 
 unsigned short int pix_bytes = 2;
 static bool pix_bytes_initialized = false;
-unsigned short int retro_bmp[RETRO_BMP_SIZE] = {0};
+unsigned short int retro_bmp_buffer[2][RETRO_BMP_SIZE] = {0};
+unsigned short int *retro_bmp = retro_bmp_buffer[0];
+bool retro_bmp_rendered = false;
+
+/* Frontend framebuffer rendered into directly during the current retro_run() */
+static struct retro_framebuffer retro_fb = {0};
+static unsigned short int *retro_fb_saved_bmp = NULL;
+static bool retro_fb_stale_bmp = false;
 unsigned int retro_bmp_offset = 0;
 
 int crop_id = -1;
@@ -207,6 +223,9 @@ unsigned int opt_audio_leak_volume = 0;
 int opt_datasette_sound_volume = 0;
 unsigned int opt_statusbar = 0;
 unsigned int opt_reset_type = 0;
+static unsigned int opt_rewind_buffer = 0;
+unsigned int opt_profiler = 0;
+bool retro_rewinding = false;
 bool opt_keyrah_keypad = false;
 bool opt_keyboard_pass_through = false;
 unsigned int opt_keyboard_keymap = KBD_INDEX_POS;
@@ -253,6 +272,7 @@ static struct retro_perf_callback perf_cb;
 
 bool libretro_supports_bitmasks = false;
 static bool libretro_supports_ff_override = false;
+static bool libretro_supports_dupe = false;
 bool libretro_ff_enabled = false;
 static bool libretro_supports_option_categories = false;
 #define HAVE_NO_LANGEXTRA
@@ -280,6 +300,9 @@ int disk_label_mode = DISK_LABEL_MODE_ASCII_OR_CAMELCASE;
 /* Forward declarations */
 bool retro_disk_set_eject_state(bool ejected);
 static void update_variables(void);
+static void retro_rewind_capture(void);
+static void retro_rewind_step(void);
+static void retro_rewind_free(void);
 
 /* Display message on next retro_run */
 static bool retro_message = false;
@@ -2879,6 +2902,40 @@ static void retro_set_core_options()
          },
          "enabled"
       },
+      {
+         "vice_rewind_buffer",
+         "System > Rewind Buffer",
+         "Rewind Buffer",
+         "Memory reserved for the core side rewind history, stepped back with the 'Hold Rewind' hotkey. Frame to frame changes are stored as deltas, so even large cartridge and RAM expansion states fit many seconds.",
+         NULL,
+         "system",
+         {
+            { "disabled", NULL },
+            { "16", "16MB" },
+            { "32", "32MB" },
+            { "64", "64MB" },
+            { "128", "128MB" },
+            { "256", "256MB" },
+            { NULL, NULL },
+         },
+         "disabled"
+      },
+      {
+         "vice_profiler",
+         "System > Sampling Profiler",
+         "Sampling Profiler",
+         "Sample the emulated CPU call stack every N cycles. Collapsed stacks for flamegraph tools ('.folded') and a pprof profile ('.pprof') are written to the save directory when content is closed or the profiler is disabled. Only frames shown by the frontend are sampled, run-ahead and frameskip frames are left out.",
+         NULL,
+         "system",
+         {
+            { "disabled", NULL },
+            { "1000", "1000 cycles" },
+            { "5000", "5000 cycles" },
+            { "20000", "20000 cycles" },
+            { NULL, NULL },
+         },
+         "disabled"
+      },
 #if !defined(__X64DTV__)
       {
          "vice_reset",
@@ -3311,6 +3368,36 @@ static void retro_set_core_options()
          "1000"
       },
 #endif
+#ifdef HAVE_THREADS
+      {
+         "vice_render_threads",
+         "Video > Render Threads",
+         "Render Threads",
+         "Split the PAL/NTSC emulation filter into horizontal bands rendered on several host threads.",
+         NULL,
+         "video",
+         {
+            { "disabled", NULL },
+            { "enabled", NULL },
+            { NULL, NULL },
+         },
+         "disabled"
+      },
+      {
+         "vice_render_pipeline",
+         "Video > Render Pipeline",
+         "Render Pipeline",
+         "Render each frame on a host thread while the next one is emulated. Adds one frame of latency.",
+         NULL,
+         "video",
+         {
+            { "disabled", NULL },
+            { "enabled", NULL },
+            { NULL, NULL },
+         },
+         "disabled"
+      },
+#endif
 #if defined(__XVIC__)
       {
          "vice_vic20_external_palette",
@@ -3855,6 +3942,22 @@ static void retro_set_core_options()
          },
          "disabled"
       },
+#endif
+#ifdef HAVE_THREADS
+      {
+         "vice_sid_threads",
+         "Audio > SID Threads",
+         "SID Threads",
+         "Render each additional SID chip on its own host thread. Only helps when several SIDs are active.",
+         NULL,
+         "audio",
+         {
+            { "disabled", NULL },
+            { "enabled", NULL },
+            { NULL, NULL },
+         },
+         "disabled"
+      },
 #endif
       {
          "vice_resid_sampling",
@@ -4409,6 +4512,16 @@ static void retro_set_core_options()
          {{ NULL, NULL }},
          "---"
       },
+      {
+         "vice_mapper_rewind",
+         "Hotkey > Hold Rewind",
+         "Hold Rewind",
+         "Hold the mapped key to step back through the core side rewind history. Requires 'Rewind Buffer'.",
+         NULL,
+         "hotkey",
+         {{ NULL, NULL }},
+         "---"
+      },
       /* Button mappings */
       {
          "vice_mapper_up",
@@ -4822,6 +4935,7 @@ static void retro_set_core_options()
             || strstr(option_defs_us[i].key, "vice_mapper_aspect_ratio_toggle")
             || strstr(option_defs_us[i].key, "vice_mapper_crop_toggle")
             || strstr(option_defs_us[i].key, "vice_mapper_warp_mode")
+            || strstr(option_defs_us[i].key, "vice_mapper_rewind")
             || strstr(option_defs_us[i].key, "vice_mapper_turbo_fire_toggle")
             || strstr(option_defs_us[i].key, "vice_mapper_save_disk_toggle")
             || strstr(option_defs_us[i].key, "vice_mapper_datasette_toggle_hotkeys")
@@ -5366,6 +5480,8 @@ void retro_set_options_display(void)
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
    option_display.key = "vice_mapper_warp_mode";
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
+   option_display.key = "vice_mapper_rewind";
+   environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
    option_display.key = "vice_mapper_turbo_fire_toggle";
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
    option_display.key = "vice_mapper_save_disk_toggle";
@@ -5407,6 +5523,10 @@ void retro_set_options_display(void)
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
    option_display.key = "vice_sid_extra";
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
+#ifdef HAVE_THREADS
+   option_display.key = "vice_sid_threads";
+   environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
+#endif
    option_display.key = "vice_resid_sampling";
    environ_cb(RETRO_ENVIRONMENT_SET_CORE_OPTIONS_DISPLAY, &option_display);
    option_display.key = "vice_resid_passband";
@@ -5575,6 +5695,18 @@ void retro_set_environment(retro_environment_t cb)
       filestream_vfs_init(&vfs_iface_info);
       dirent_vfs_init(&vfs_iface_info);
       path_vfs_init(&vfs_iface_info);
+      memfile_vfs_init(&vfs_iface_info);
+   }
+   else
+   {
+      /* Frontends with only the version 1 file functions are still used,
+       * through the memory file layer */
+      vfs_iface_info.required_interface_version = 1;
+      vfs_iface_info.iface                      = NULL;
+      if (environ_cb(RETRO_ENVIRONMENT_GET_VFS_INTERFACE, &vfs_iface_info) && vfs_iface_info.iface)
+         memfile_vfs_init(&vfs_iface_info);
+      else
+         memfile_vfs_init(NULL);
    }
 #endif
 }
@@ -5615,6 +5747,38 @@ char* get_variable(const char* key)
    return NULL;
 }
 
+static void retro_profiler_write(void)
+{
+   const char *content_path = (dc && !string_is_empty(dc->files[0])) ? dc->files[0] : full_path;
+   char content_base[RETRO_PATH_MAX];
+   char profile_path[RETRO_PATH_MAX];
+
+   strlcpy(content_base, string_is_empty(content_path) ? "vice" : path_basename(content_path), sizeof(content_base));
+   path_remove_extension(content_base);
+
+   snprintf(profile_path, sizeof(profile_path), "%s%s%s.folded", retro_save_directory, ARCHDEP_DIR_SEP_STR, content_base);
+   if (profile_write_collapsed(profile_path) == 0)
+      log_cb(RETRO_LOG_INFO, "Profile written to \"%s\"\n", profile_path);
+
+   snprintf(profile_path, sizeof(profile_path), "%s%s%s.pprof", retro_save_directory, ARCHDEP_DIR_SEP_STR, content_base);
+   if (profile_write_pprof(profile_path) == 0)
+      log_cb(RETRO_LOG_INFO, "Profile written to \"%s\"\n", profile_path);
+}
+
+/* Restart the sampling profiler with a new interval, 0 stops it. Whatever
+ * was collected so far is written out first. */
+void retro_profiler_set(unsigned int interval)
+{
+   if (profile_sampling)
+   {
+      profile_stop();
+      retro_profiler_write();
+   }
+
+   if (interval && profile_sampling_start(interval) < 0)
+      log_cb(RETRO_LOG_ERROR, "Sampling profiler could not be started\n");
+}
+
 #define GET_VAR(x) \
    var.key   = "vice_" x; \
    var.value = NULL; \
@@ -5628,6 +5792,10 @@ static void update_variables(void)
    log_cb(RETRO_LOG_INFO, "Updating variables, UI finalized = %d\n", retro_ui_finalized);
 #endif
 
+   /* Options change renderer and palette state, which the pipeline worker
+    * must not be using at the same time */
+   video_pipeline_sync();
+
 #if !defined(__XPET__) && !defined(__X64DTV__)
    GET_VAR("cartridge")
    {
@@ -6374,6 +6542,14 @@ static void update_variables(void)
    }
 #endif
 
+#ifdef HAVE_THREADS
+   GET_VAR("sid_threads")
+   {
+      if (!strcmp(var.value, "disabled")) sid_threads_set(0);
+      else                                sid_threads_set(1);
+   }
+#endif
+
    GET_VAR("resid_sampling")
    {
       int val = 0;
@@ -6622,6 +6798,20 @@ static void update_variables(void)
       vice_opt.Filter = blur;
    }
 
+#ifdef HAVE_THREADS
+   GET_VAR("render_threads")
+   {
+      if (!strcmp(var.value, "disabled")) video_render_threads_set(0);
+      else                                video_render_threads_set(1);
+   }
+
+   GET_VAR("render_pipeline")
+   {
+      if (!strcmp(var.value, "disabled")) video_pipeline_set(0);
+      else                                video_pipeline_set(1);
+   }
+#endif
+
 #if defined(__X64__) || defined(__X64SC__) || defined(__X64DTV__) || defined(__X128__) || defined(__XSCPU64__) || defined(__XCBM5x0__)
    GET_VAR("vicii_filter_oddline_phase")
 #elif defined(__XVIC__)
@@ -7023,6 +7213,22 @@ static void update_variables(void)
       else                                opt_keyboard_pass_through = true;
    }
 
+   GET_VAR("rewind_buffer")
+   {
+      opt_rewind_buffer = (!strcmp(var.value, "disabled")) ? 0 : atoi(var.value);
+      if (snapshot_rewind_init((size_t)opt_rewind_buffer * 1024 * 1024) < 0)
+         opt_rewind_buffer = 0;
+      retro_rewinding = false;
+   }
+
+   GET_VAR("profiler")
+   {
+      unsigned int interval = (!strcmp(var.value, "disabled")) ? 0 : atoi(var.value);
+      if (retro_ui_finalized && opt_profiler != interval)
+         retro_profiler_set(interval);
+      opt_profiler = interval;
+   }
+
 #if !defined(__X64DTV__)
    GET_VAR("reset")
    {
@@ -7329,6 +7535,11 @@ static void update_variables(void)
       mapper_keys[RETRO_MAPPER_WARP_MODE] = retro_keymap_id(var.value);
    }
 
+   GET_VAR("mapper_rewind")
+   {
+      mapper_keys[RETRO_MAPPER_REWIND] = retro_keymap_id(var.value);
+   }
+
    GET_VAR("mapper_turbo_fire_toggle")
    {
       mapper_keys[RETRO_MAPPER_TURBO_FIRE] = retro_keymap_id(var.value);
@@ -7379,6 +7590,9 @@ static void update_variables(void)
 
    /* Hide/show core options */
    retro_set_options_display();
+
+   /* Options may attach cartridges, change drives or expansions */
+   retro_snapshot_size_invalidate();
 }
 
 void emu_reset(int type)
@@ -7767,10 +7981,13 @@ void retro_init(void)
    if (environ_cb(RETRO_ENVIRONMENT_SET_FASTFORWARDING_OVERRIDE, NULL))
       libretro_supports_ff_override = true;
 
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_CAN_DUPE, &libretro_supports_dupe))
+      libretro_supports_dupe = false;
+
    bool achievements = true;
    environ_cb(RETRO_ENVIRONMENT_SET_SUPPORT_ACHIEVEMENTS, &achievements);
 
-   memset(retro_bmp, 0, sizeof(retro_bmp));
+   memset(retro_bmp_buffer, 0, sizeof(retro_bmp_buffer));
    init_output_audio_buffer(2048);
 
    retro_ui_finalized = false;
@@ -7796,16 +8013,27 @@ void retro_deinit(void)
    /* Clean dynamic core option info */
    free_vice_core_options();
 
+   /* Stop the render pipeline worker, then the render threads */
+   video_pipeline_set(0);
+#ifdef HAVE_THREADS
+   video_render_threads_set(0);
+   sid_threads_set(0);
+#endif
+
    /* Free buffers used by libretro-graph */
    libretro_graph_free();
 
    /* Free audio buffer */
    free_output_audio_buffer();
 
+   /* Free rewind history */
+   retro_rewind_free();
+
    /* 'Reset' troublesome static variables */
    pix_bytes_initialized = false;
    libretro_supports_bitmasks = false;
    libretro_supports_ff_override = false;
+   libretro_supports_dupe = false;
    libretro_supports_option_categories = false;
 }
 
@@ -8260,6 +8488,90 @@ void emu_model_set(int model)
 
 #define AUTOLOADWARP_TAPE_DEBUG 0
 
+/* Borrow the frontend framebuffer as retro_bmp for this frame when it has
+ * the exact layout of retro_bmp: no cropping, same pitch and format, and
+ * cached memory since the overlays blend into it. Frames not rendered into
+ * it are shown as dupes, so the frontend must support those. */
+static void retro_fb_acquire(void)
+{
+   retro_fb.data = NULL;
+
+   if (     retro_video_hidden
+         || !libretro_supports_dupe
+         || video_pipeline_enabled
+         || retro_bmp_offset
+         || retrow_crop != retrow
+         || retroh_crop != retroh)
+      return;
+
+   retro_fb.width        = retrow;
+   retro_fb.height       = retroh;
+   retro_fb.access_flags = RETRO_MEMORY_ACCESS_WRITE | RETRO_MEMORY_ACCESS_READ;
+
+   if (     !environ_cb(RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER, &retro_fb)
+         || !retro_fb.data
+         || retro_fb.pitch != retrow * pix_bytes
+         || retro_fb.format != (pix_bytes == 4 ? RETRO_PIXEL_FORMAT_XRGB8888 : RETRO_PIXEL_FORMAT_RGB565)
+         || !(retro_fb.memory_flags & RETRO_MEMORY_TYPE_CACHED))
+   {
+      retro_fb.data = NULL;
+      return;
+   }
+
+   retro_fb_saved_bmp = retro_bmp;
+   retro_bmp          = (unsigned short int *)retro_fb.data;
+   retro_fb_stale_bmp = true;
+}
+
+/* The frontend framebuffer was sized for the geometry at the start of the
+ * frame, go back to retro_bmp before rendering if that has changed since */
+void retro_fb_check(void)
+{
+   if (     !retro_fb.data
+         || (  retro_fb.width  == retrow
+            && retro_fb.height == retroh
+            && retro_fb.pitch  == retrow * pix_bytes))
+      return;
+
+   retro_bmp          = retro_fb_saved_bmp;
+   retro_bmp_rendered = false;
+   retro_fb.data      = NULL;
+}
+
+static void retro_video_output(void)
+{
+   if (!retro_fb.data)
+   {
+      /* retro_bmp missed the frames rendered into the frontend framebuffer,
+       * keep showing dupes until it holds a whole frame again */
+      if (retro_fb_stale_bmp)
+      {
+         if (!retro_bmp_rendered)
+         {
+            video_cb(NULL, retrow_crop, retroh_crop, retrow << (pix_bytes >> 1));
+            return;
+         }
+         retro_fb_stale_bmp = false;
+      }
+      video_cb(retro_bmp + retro_bmp_offset, retrow_crop, retroh_crop, retrow << (pix_bytes >> 1));
+      return;
+   }
+
+   retro_bmp = retro_fb_saved_bmp;
+
+   /* Contents are undefined unless the whole frame was rendered into it
+    * with the layout it was requested for */
+   if (     retro_bmp_rendered
+         && retro_fb.width  == retrow_crop
+         && retro_fb.height == retroh_crop
+         && !retro_bmp_offset)
+      video_cb(retro_fb.data, retro_fb.width, retro_fb.height, retro_fb.pitch);
+   else
+      video_cb(NULL, retrow_crop, retroh_crop, retrow << (pix_bytes >> 1));
+
+   retro_fb.data = NULL;
+}
+
 void retro_run(void)
 {
    /* Core options */
@@ -8409,16 +8721,45 @@ void retro_run(void)
 #endif
    }
 
+   /* Run-ahead and fast-forward frames the frontend will not show are
+    * still emulated exactly, only rendering is skipped */
+   {
+      int av_enable = 3;
+
+      if (!environ_cb(RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE, &av_enable))
+         av_enable = 3;
+      retro_video_hidden = !(av_enable & 1);
+   }
+
+   /* Only shown frames are profiled, so run-ahead does not count the
+    * frames it replays */
+   profile_sampling_hold(retro_video_hidden);
+
+   /* Render straight into frontend memory when possible */
+   retro_bmp_rendered = false;
+   retro_fb_acquire();
+
    /* Input poll */
    input_poll_cb();
    retro_poll_event();
 
+   /* Core side rewind steps back before the frame is emulated */
+   if (opt_rewind_buffer && retro_rewinding)
+      retro_rewind_step();
+
    /* Main loop */
    while (retro_renderloop)
       maincpu_mainloop();
    retro_renderloop = 1;
    retro_now += 1000000 / retro_refresh;
 
+   /* Render the frame just emulated on the pipeline worker */
+   video_pipeline_submit();
+
+   /* Core side rewind history */
+   if (opt_rewind_buffer && !retro_rewinding)
+      retro_rewind_capture();
+
    retro_sound_keep_alive = false;
 
    /* LED interface */
@@ -8446,12 +8787,16 @@ void retro_run(void)
    /* Virtual keyboard */
    /* Moved to retrodep video_canvas_refresh() in order to stop flashing during warping */
 
+   /* Present the previous frame when pipelining */
+   video_pipeline_present();
+
    /* Statusbar message timer */
    if (statusbar_message_timer > 0)
       statusbar_message_timer--;
 
    /* Forced statusbar messages */
-   if ((!retro_statusbar && opt_statusbar & STATUSBAR_MESSAGES && statusbar_message_timer) || retro_statusbar)
+   if (     !retro_video_hidden
+         && ((!retro_statusbar && opt_statusbar & STATUSBAR_MESSAGES && statusbar_message_timer) || retro_statusbar))
       uistatusbar_draw();
 
    /* Set volume back to maximum after starting with mute, due to ReSID 6581 init pop */
@@ -8467,7 +8812,7 @@ void retro_run(void)
    }
 
    /* Video output */
-   video_cb(retro_bmp + retro_bmp_offset, retrow_crop, retroh_crop, retrow << (pix_bytes >> 1));
+   retro_video_output();
 
    /* Audio output */
    upload_output_audio_buffer();
@@ -8588,6 +8933,9 @@ bool retro_load_game(const struct retro_game_info *info)
 
 void retro_unload_game(void)
 {
+   /* Write out profiles */
+   retro_profiler_set(0);
+
    /* Gzip savedisks */
    if (dc)
       dc_save_disk_compress(dc);
@@ -8711,15 +9059,28 @@ static void retro_unserialize_post(void)
    vice_led_state[RETRO_LED_POWER] = vice_led_state[RETRO_LED_DRIVE] = vice_led_state[RETRO_LED_TAPE] = 0;
    /* Dismiss possible restart request */
    request_restart = false;
+   /* Sample alarm follows the restored clock */
+   profile_sampling_resync();
    /* Sync Disc Control index for D64 multidisks */
    dc_sync_index();
 }
 
+/* Snapshot size only changes when the attached media, drives, expansions or
+ * machine configuration change, so it is measured once and then cached.
+ * Every successful serialize also refreshes the cache with the real size. */
+void retro_snapshot_size_invalidate(void)
+{
+   snapshot_size_dirty = true;
+}
+
 size_t retro_serialize_size(void)
 {
    long snapshot_size = 0;
    if (retro_ui_finalized)
    {
+      if (!snapshot_size_dirty)
+         return snapshot_size_cached;
+
       snapshot_stream = snapshot_memory_write_fopen(NULL, 0);
       int success = 0;
       interrupt_maincpu_trigger_trap(save_trap, (void *)&success);
@@ -8732,6 +9093,8 @@ size_t retro_serialize_size(void)
          {
             snapshot_fseek(snapshot_stream, 0, SEEK_END);
             snapshot_size = snapshot_ftell(snapshot_stream);
+            snapshot_size_cached = snapshot_size;
+            snapshot_size_dirty = false;
          }
          else
          {
@@ -8758,11 +9121,13 @@ size_t retro_serialize_size(void)
    return snapshot_size;
 }
 
-bool retro_serialize(void *data_, size_t size)
+/* A non-zero `incremental_id' promises that `data_' still holds the state
+ * last written with that id, see snapshot_memory_write_incremental_fopen() */
+static bool retro_serialize_incremental(void *data_, size_t size, unsigned int incremental_id)
 {
    if (retro_ui_finalized)
    {
-      snapshot_stream = snapshot_memory_write_fopen(data_, size);
+      snapshot_stream = snapshot_memory_write_incremental_fopen(data_, size, incremental_id);
       int success = 0;
       interrupt_maincpu_trigger_trap(save_trap, (void *)&success);
       save_trap_happened = 0;
@@ -8770,6 +9135,12 @@ bool retro_serialize(void *data_, size_t size)
          maincpu_mainloop();
       if (snapshot_stream != NULL)
       {
+         if (success)
+         {
+            snapshot_fseek(snapshot_stream, 0, SEEK_END);
+            snapshot_size_cached = snapshot_ftell(snapshot_stream);
+            snapshot_size_dirty = false;
+         }
          snapshot_fclose(snapshot_stream);
          snapshot_stream = NULL;
       }
@@ -8777,11 +9148,18 @@ bool retro_serialize(void *data_, size_t size)
       {
          return true;
       }
+      /* Most likely outgrown the buffer, so measure again on next request */
+      retro_snapshot_size_invalidate();
       log_cb(RETRO_LOG_ERROR, "Failed to serialize snapshot.\n");
    }
    return false;
 }
 
+bool retro_serialize(void *data_, size_t size)
+{
+   return retro_serialize_incremental(data_, size, 0);
+}
+
 bool retro_unserialize(const void *data_, size_t size)
 {
    if (retro_ui_finalized)
@@ -8802,6 +9180,10 @@ bool retro_unserialize(const void *data_, size_t size)
          snapshot_fclose(snapshot_stream);
          snapshot_stream = NULL;
       }
+      /* Rewind and run-ahead states match the cached size, anything else
+       * may have come from a different configuration */
+      if (size != snapshot_size_cached)
+         retro_snapshot_size_invalidate();
       if (success)
       {
          retro_unserialize_post();
@@ -8812,6 +9194,51 @@ bool retro_unserialize(const void *data_, size_t size)
    return false;
 }
 
+/* Core side rewind, see snapshot_rewind.c */
+static uint8_t *rewind_state = NULL;
+static size_t rewind_state_size = 0;
+/* Capture buffer keeps the previous state, so large memories only copy
+ * their dirty pages. A new id forces a full write. */
+static unsigned int rewind_state_id = 1;
+
+static void retro_rewind_capture(void)
+{
+   size_t size = retro_serialize_size();
+
+   if (!size)
+      return;
+
+   if (rewind_state_size < size)
+   {
+      rewind_state      = (uint8_t *)realloc(rewind_state, size);
+      rewind_state_size = size;
+      rewind_state_id++;
+   }
+
+   if (rewind_state && retro_serialize_incremental(rewind_state, size, rewind_state_id))
+      snapshot_rewind_push(rewind_state, snapshot_size_cached);
+   else
+      rewind_state_id++;
+}
+
+static void retro_rewind_step(void)
+{
+   const uint8_t *state = NULL;
+   size_t size          = snapshot_rewind_pop(&state);
+
+   if (size)
+      retro_unserialize(state, size);
+}
+
+static void retro_rewind_free(void)
+{
+   snapshot_rewind_shutdown();
+   free(rewind_state);
+   rewind_state      = NULL;
+   rewind_state_size = 0;
+   rewind_state_id++;
+}
+
 void *retro_get_memory_data(unsigned id)
 {
    if (id == RETRO_MEMORY_SYSTEM_RAM)
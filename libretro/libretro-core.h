@@ -63,7 +63,12 @@ typedef uint8_t uint8;
 #define WINDOW_HEIGHT 288
 #endif
 #define RETRO_BMP_SIZE (WINDOW_WIDTH * WINDOW_HEIGHT * 2)
-extern unsigned short int retro_bmp[RETRO_BMP_SIZE];
+/* retro_bmp points to the buffer presented to the frontend, which is one of
+ * retro_bmp_buffer[] (the other one is rendered to when pipelining) */
+extern unsigned short int retro_bmp_buffer[2][RETRO_BMP_SIZE];
+extern unsigned short int *retro_bmp;
+extern bool retro_bmp_rendered;
+extern void retro_fb_check(void);
 extern unsigned short int pix_bytes;
 
 #define MANUAL_CROP_OPTIONS \
@@ -164,6 +169,19 @@ extern int tape_motor;
 extern int tape_found_counter;
 
 extern unsigned int retro_warpmode;
+extern bool retro_rewinding;
+extern bool retro_video_hidden;
+
+/* Sampling profiler */
+extern unsigned int opt_profiler;
+extern void retro_profiler_set(unsigned int interval);
+
+/* Frame pipelining, retrodep/video.c */
+extern int video_pipeline_enabled;
+extern void video_pipeline_sync(void);
+extern void video_pipeline_set(int enable);
+extern void video_pipeline_submit(void);
+extern void video_pipeline_present(void);
 extern int crop_id;
 extern int crop_id_prev;
 extern bool crop_delay;
@@ -265,6 +283,7 @@ extern void display_retro_message(const char *message);
 extern void statusbar_message_show(signed char icon, const char *format, ...);
 extern void set_variable(const char *key, const char *value);
 extern char* get_variable(const char *key);
+extern void retro_snapshot_size_invalidate(void);
 
 extern void emu_function(int function);
 enum EMU_FUNCTIONS
@@ -279,6 +298,7 @@ enum EMU_FUNCTIONS
    EMU_CROP,
    EMU_TURBO_FIRE,
    EMU_WARP_MODE,
+   EMU_REWIND,
    EMU_DATASETTE_HOTKEYS,
    EMU_DATASETTE_STOP,
    EMU_DATASETTE_START,
@@ -366,6 +386,18 @@ struct vice_raster_s
 
    unsigned counter;
    unsigned blanked;
+
+   /* Auto crop content detection, done by the raster while drawing.
+    * Columns and rows are in retro_bmp coordinates, rows between
+    * crop_top and crop_bottom are not checked, crop_xe 0 disables. */
+   void *crop_canvas;
+   unsigned crop_xs;
+   unsigned crop_xe;
+   unsigned crop_lb;
+   unsigned crop_rb;
+   unsigned crop_top;
+   unsigned crop_bottom;
+   unsigned char content[WINDOW_HEIGHT];
 };
 
 extern struct vice_raster_s vice_raster;
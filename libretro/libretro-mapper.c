@@ -302,6 +302,9 @@ void emu_function(int function)
          retro_warpmode = (retro_warpmode) ? 0 : 1;
          vsync_set_warp_mode(retro_warpmode);
          break;
+      case EMU_REWIND:
+         retro_rewinding = !retro_rewinding;
+         break;
       case EMU_DATASETTE_HOTKEYS:
 #if defined(__X64DTV__) || defined(__XSCPU64__)
          break;
@@ -537,6 +540,9 @@ void update_input(uint8_t disable_keys)
             case RETRO_MAPPER_SAVE_DISK:
                emu_function(EMU_SAVE_DISK);
                break;
+            case RETRO_MAPPER_REWIND:
+               emu_function(EMU_REWIND);
+               break;
             case RETRO_MAPPER_DATASETTE_HOTKEYS:
                emu_function(EMU_DATASETTE_HOTKEYS);
                break;
@@ -585,6 +591,9 @@ void update_input(uint8_t disable_keys)
             case RETRO_MAPPER_WARP_MODE:
                emu_function(EMU_WARP_MODE);
                break;
+            case RETRO_MAPPER_REWIND:
+               emu_function(EMU_REWIND);
+               break;
          }
       }
       else if (mapper_keys_pressed_time)
@@ -731,6 +740,8 @@ void update_input(uint8_t disable_keys)
                   emu_function(EMU_TURBO_FIRE);
                else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_SAVE_DISK])
                   emu_function(EMU_SAVE_DISK);
+               else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_REWIND])
+                  emu_function(EMU_REWIND);
                else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_DATASETTE_HOTKEYS])
                   emu_function(EMU_DATASETTE_HOTKEYS);
                else if (datasette_hotkeys && mapper_keys[i] == mapper_keys[RETRO_MAPPER_DATASETTE_STOP])
@@ -804,6 +815,8 @@ void update_input(uint8_t disable_keys)
                   ; /* nop */
                else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_SAVE_DISK])
                   ; /* nop */
+               else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_REWIND])
+                  emu_function(EMU_REWIND);
                else if (mapper_keys[i] == mapper_keys[RETRO_MAPPER_DATASETTE_HOTKEYS])
                   ; /* nop */
                else if (datasette_hotkeys && mapper_keys[i] == mapper_keys[RETRO_MAPPER_DATASETTE_STOP])
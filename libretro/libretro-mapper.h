@@ -32,15 +32,16 @@
 #define RETRO_MAPPER_WARP_MODE          30
 #define RETRO_MAPPER_TURBO_FIRE         31
 #define RETRO_MAPPER_SAVE_DISK          32
+#define RETRO_MAPPER_REWIND             33
 
-#define RETRO_MAPPER_DATASETTE_HOTKEYS  33
-#define RETRO_MAPPER_DATASETTE_STOP     34
-#define RETRO_MAPPER_DATASETTE_START    35
-#define RETRO_MAPPER_DATASETTE_FORWARD  36
-#define RETRO_MAPPER_DATASETTE_REWIND   37
-#define RETRO_MAPPER_DATASETTE_RESET    38
+#define RETRO_MAPPER_DATASETTE_HOTKEYS  34
+#define RETRO_MAPPER_DATASETTE_STOP     35
+#define RETRO_MAPPER_DATASETTE_START    36
+#define RETRO_MAPPER_DATASETTE_FORWARD  37
+#define RETRO_MAPPER_DATASETTE_REWIND   38
+#define RETRO_MAPPER_DATASETTE_RESET    39
 
-#define RETRO_MAPPER_LAST               39
+#define RETRO_MAPPER_LAST               40
 
 #define TOGGLE_VKBD                     -31
 #define TOGGLE_STATUSBAR                -32
@@ -0,0 +1,415 @@
+/*
+ * memfile.c - Memory backed streams and file mappings.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib.h"
+#include "log.h"
+#include "types.h"
+
+#include "memfile.h"
+
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef USE_LIBRETRO_VFS
+#include <libretro.h>
+#include <streams/file_stream.h>
+#include <vfs/vfs_implementation.h>
+
+/* Name the VFS open callback recognizes, the buffer itself is passed on the
+   side in `memfile_pending' */
+#define MEMFILE_PATH "memfile:"
+
+typedef struct memfile_handle_s {
+    memfile_buffer_t *buf;
+    size_t pos;
+    int writable;
+    struct memfile_handle_s *next;
+} memfile_handle_t;
+
+/* What the file streams use while no memory stream is open, the frontend
+   VFS or a NULL iface for the built-in one */
+static struct retro_vfs_interface_info memfile_base_info;
+static const struct retro_vfs_interface *memfile_base = NULL;
+static unsigned memfile_base_version = 0;
+static struct retro_vfs_interface memfile_iface;
+static int memfile_ready = 0;
+
+/* Open memory streams. Streams of the underlying VFS are handed out as they
+   are, so they stay valid whether this layer is in front or not. */
+static memfile_handle_t *memfile_handles = NULL;
+static memfile_handle_t *memfile_pending = NULL;
+
+#define MEMFILE_IMPL(file) ((libretro_vfs_implementation_file *)(file))
+
+static memfile_handle_t *memfile_find(struct retro_vfs_file_handle *stream)
+{
+    memfile_handle_t *h;
+
+    for (h = memfile_handles; h != NULL; h = h->next) {
+        if ((struct retro_vfs_file_handle *)h == stream) {
+            return h;
+        }
+    }
+    return NULL;
+}
+
+static void memfile_vfs_install(int enable)
+{
+    struct retro_vfs_interface_info info;
+
+    /* The file streams only take a version 2 VFS, an older one is always
+       reached through this layer */
+    if (enable || memfile_base_version < 2) {
+        info.required_interface_version = 2;
+        info.iface = &memfile_iface;
+        filestream_vfs_init(&info);
+    } else {
+        filestream_vfs_init(&memfile_base_info);
+    }
+}
+
+/* Make room for `size' bytes, doubling the allocation */
+static void memfile_reserve(memfile_buffer_t *buf, size_t size)
+{
+    size_t alloc;
+
+    if (size <= buf->alloc) {
+        return;
+    }
+    alloc = buf->alloc ? buf->alloc : 0x10000;
+    while (alloc < size) {
+        alloc *= 2;
+    }
+    buf->data = lib_realloc(buf->data, alloc);
+    buf->alloc = alloc;
+}
+
+/* Set the size of the data, new bytes are zero like in a file extended by
+   seeking past its end */
+static void memfile_resize(memfile_buffer_t *buf, size_t size)
+{
+    memfile_reserve(buf, size);
+    if (size > buf->size) {
+        memset(buf->data + buf->size, 0, size - buf->size);
+    }
+    buf->size = size;
+}
+
+static const char *RETRO_CALLCONV memfile_get_path(struct retro_vfs_file_handle *stream)
+{
+    if (memfile_find(stream) != NULL) {
+        return MEMFILE_PATH;
+    }
+    return memfile_base ? memfile_base->get_path(stream) : retro_vfs_file_get_path_impl(MEMFILE_IMPL(stream));
+}
+
+static struct retro_vfs_file_handle *RETRO_CALLCONV memfile_vfs_open(const char *path, unsigned mode, unsigned hints)
+{
+    memfile_handle_t *h;
+
+    if (path != NULL && !strcmp(path, MEMFILE_PATH) && memfile_pending != NULL) {
+        h = memfile_pending;
+        memfile_pending = NULL;
+        h->next = memfile_handles;
+        memfile_handles = h;
+        return (struct retro_vfs_file_handle *)h;
+    }
+
+    return memfile_base ? memfile_base->open(path, mode, hints)
+                        : (struct retro_vfs_file_handle *)retro_vfs_file_open_impl(path, mode, hints);
+}
+
+static int RETRO_CALLCONV memfile_close(struct retro_vfs_file_handle *stream)
+{
+    memfile_handle_t *h = memfile_find(stream);
+    memfile_handle_t **p;
+
+    if (h == NULL) {
+        return memfile_base ? memfile_base->close(stream) : retro_vfs_file_close_impl(MEMFILE_IMPL(stream));
+    }
+
+    for (p = &memfile_handles; *p != h; p = &(*p)->next) {
+    }
+    *p = h->next;
+    lib_free(h);
+
+    /* Last one gone, the file streams go straight to the VFS again */
+    if (memfile_handles == NULL) {
+        memfile_vfs_install(0);
+    }
+    return 0;
+}
+
+static int64_t RETRO_CALLCONV memfile_size(struct retro_vfs_file_handle *stream)
+{
+    memfile_handle_t *h = memfile_find(stream);
+
+    if (h == NULL) {
+        return memfile_base ? memfile_base->size(stream) : retro_vfs_file_size_impl(MEMFILE_IMPL(stream));
+    }
+    return (int64_t)h->buf->size;
+}
+
+static int64_t RETRO_CALLCONV memfile_truncate(struct retro_vfs_file_handle *stream, int64_t length)
+{
+    memfile_handle_t *h = memfile_find(stream);
+
+    if (h == NULL) {
+        if (memfile_base) {
+            /* truncate only exists from version 2 of the interface on */
+            return memfile_base_version >= 2 ? memfile_base->truncate(stream, length) : -1;
+        }
+        return retro_vfs_file_truncate_impl(MEMFILE_IMPL(stream), length);
+    }
+    if (!h->writable || length < 0 || (uint64_t)length > SIZE_MAX / 2) {
+        return -1;
+    }
+    memfile_resize(h->buf, (size_t)length);
+    h->buf->dirty = 1;
+    return 0;
+}
+
+static int64_t RETRO_CALLCONV memfile_tell(struct retro_vfs_file_handle *stream)
+{
+    memfile_handle_t *h = memfile_find(stream);
+
+    if (h == NULL) {
+        return memfile_base ? memfile_base->tell(stream) : retro_vfs_file_tell_impl(MEMFILE_IMPL(stream));
+    }
+    return (int64_t)h->pos;
+}
+
+static int64_t RETRO_CALLCONV memfile_seek(struct retro_vfs_file_handle *stream, int64_t offset, int seek_position)
+{
+    memfile_handle_t *h = memfile_find(stream);
+    int64_t pos;
+
+    if (h == NULL) {
+        return memfile_base ? memfile_base->seek(stream, offset, seek_position)
+                            : retro_vfs_file_seek_impl(MEMFILE_IMPL(stream), offset, seek_position);
+    }
+
+    switch (seek_position) {
+        case RETRO_VFS_SEEK_POSITION_START:
+            pos = offset;
+            break;
+        case RETRO_VFS_SEEK_POSITION_CURRENT:
+            pos = (int64_t)h->pos + offset;
+            break;
+        case RETRO_VFS_SEEK_POSITION_END:
+            pos = (int64_t)h->buf->size + offset;
+            break;
+        default:
+            return -1;
+    }
+    /* Past the end is fine for writing, as with files */
+    if (pos < 0 || (uint64_t)pos > (h->writable ? SIZE_MAX / 2 : h->buf->size)) {
+        return -1;
+    }
+    h->pos = (size_t)pos;
+    return 0;
+}
+
+static int64_t RETRO_CALLCONV memfile_read(struct retro_vfs_file_handle *stream, void *s, uint64_t len)
+{
+    memfile_handle_t *h = memfile_find(stream);
+
+    if (h == NULL) {
+        return memfile_base ? memfile_base->read(stream, s, len) : retro_vfs_file_read_impl(MEMFILE_IMPL(stream), s, len);
+    }
+
+    if (h->pos >= h->buf->size) {
+        return 0;
+    }
+    if (len > h->buf->size - h->pos) {
+        len = h->buf->size - h->pos;
+    }
+    memcpy(s, h->buf->data + h->pos, (size_t)len);
+    h->pos += (size_t)len;
+    return (int64_t)len;
+}
+
+static int64_t RETRO_CALLCONV memfile_write(struct retro_vfs_file_handle *stream, const void *s, uint64_t len)
+{
+    memfile_handle_t *h = memfile_find(stream);
+
+    if (h == NULL) {
+        return memfile_base ? memfile_base->write(stream, s, len) : retro_vfs_file_write_impl(MEMFILE_IMPL(stream), s, len);
+    }
+
+    if (!h->writable || len > SIZE_MAX / 2 - h->pos) {
+        return -1;
+    }
+    if (h->pos + len > h->buf->size) {
+        memfile_resize(h->buf, h->pos + (size_t)len);
+    }
+    memcpy(h->buf->data + h->pos, s, (size_t)len);
+    h->pos += (size_t)len;
+    h->buf->dirty = 1;
+    return (int64_t)len;
+}
+
+static int RETRO_CALLCONV memfile_flush(struct retro_vfs_file_handle *stream)
+{
+    if (memfile_find(stream) != NULL) {
+        return 0;
+    }
+    return memfile_base ? memfile_base->flush(stream) : retro_vfs_file_flush_impl(MEMFILE_IMPL(stream));
+}
+
+static int RETRO_CALLCONV memfile_remove(const char *path)
+{
+    return memfile_base ? memfile_base->remove(path) : retro_vfs_file_remove_impl(path);
+}
+
+static int RETRO_CALLCONV memfile_rename(const char *old_path, const char *new_path)
+{
+    return memfile_base ? memfile_base->rename(old_path, new_path) : retro_vfs_file_rename_impl(old_path, new_path);
+}
+
+/* Remember the VFS the file streams were set up with, `vfs_info' is what
+   the frontend returned or NULL if it has none. The memory layer is only
+   put in front of it while memory streams are open, except for a version 1
+   VFS which the file streams cannot use on their own. */
+void memfile_vfs_init(const struct retro_vfs_interface_info *vfs_info)
+{
+    memfile_base = (vfs_info != NULL) ? vfs_info->iface : NULL;
+    memfile_base_version = (memfile_base != NULL) ? vfs_info->required_interface_version : 2;
+    memfile_base_info.required_interface_version = 2;
+    memfile_base_info.iface = (struct retro_vfs_interface *)memfile_base;
+
+    memset(&memfile_iface, 0, sizeof(memfile_iface));
+    memfile_iface.get_path = memfile_get_path;
+    memfile_iface.open = memfile_vfs_open;
+    memfile_iface.close = memfile_close;
+    memfile_iface.size = memfile_size;
+    memfile_iface.tell = memfile_tell;
+    memfile_iface.seek = memfile_seek;
+    memfile_iface.read = memfile_read;
+    memfile_iface.write = memfile_write;
+    memfile_iface.flush = memfile_flush;
+    memfile_iface.remove = memfile_remove;
+    memfile_iface.rename = memfile_rename;
+    memfile_iface.truncate = memfile_truncate;
+
+    memfile_ready = 1;
+
+    if (memfile_base_version < 2) {
+        log_warning(LOG_DEFAULT, "memfile: frontend VFS is version %u, files cannot be truncated.",
+                    memfile_base_version);
+        memfile_vfs_install(1);
+    }
+}
+
+FILE *memfile_open(memfile_buffer_t *buf, const char *mode)
+{
+    memfile_handle_t *h;
+    FILE *stream;
+
+    /* "w" and "a" would throw the data away or need it elsewhere */
+    if (!memfile_ready || mode[0] != 'r') {
+        return NULL;
+    }
+
+    h = lib_calloc(1, sizeof(memfile_handle_t));
+    h->buf = buf;
+    h->writable = (strchr(mode, '+') != NULL);
+
+    if (memfile_handles == NULL) {
+        memfile_vfs_install(1);
+    }
+    memfile_pending = h;
+    stream = fopen(MEMFILE_PATH, mode);
+    if (stream == NULL) {
+        memfile_pending = NULL;
+        lib_free(h);
+        if (memfile_handles == NULL) {
+            memfile_vfs_install(0);
+        }
+    }
+    return stream;
+}
+
+#else /* !USE_LIBRETRO_VFS */
+
+FILE *memfile_open(memfile_buffer_t *buf, const char *mode)
+{
+#ifdef HAVE_FMEMOPEN
+    /* fmemopen() cannot grow the buffer, only reading is done here */
+    if ((strcmp(mode, "r") != 0 && strcmp(mode, "rb") != 0) || buf->size == 0) {
+        return NULL;
+    }
+    return fmemopen(buf->data, buf->size, mode);
+#else
+    return NULL;
+#endif
+}
+
+#endif /* USE_LIBRETRO_VFS */
+
+const uint8_t *memfile_map(const char *path, size_t *size)
+{
+#ifdef HAVE_MMAP
+    struct stat st;
+    void *data;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    *size = (size_t)st.st_size;
+    return (const uint8_t *)data;
+#else
+    return NULL;
+#endif
+}
+
+void memfile_unmap(const uint8_t *data, size_t size)
+{
+#ifdef HAVE_MMAP
+    if (data != NULL) {
+        munmap((void *)data, size);
+    }
+#endif
+}
@@ -0,0 +1,66 @@
+/*
+ * memfile.h - Memory backed streams and file mappings.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef MEMFILE_H
+#define MEMFILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "types.h"
+
+/* Memory backed streams.
+ *
+ * A buffer is handed out as an ordinary stream, so that decompressed images
+ * can be attached without going through a temporary file. The buffer stays
+ * owned by the caller and must outlive the stream. Streams opened "r+" write
+ * into the buffer, which grows with lib_realloc() as needed, and `dirty' is
+ * set so the caller knows to store the data again once the stream is closed.
+ *
+ * With the libretro VFS the streams are served by a thin layer on top of the
+ * frontend (or built-in) VFS, which is put in front of the file streams only
+ * while memory streams are open, or for good with a version 1 frontend VFS. Otherwise fmemopen() is used where the C
+ * library has it, for read-only streams. memfile_open() returns NULL when a
+ * stream cannot be had, callers fall back to temporary files then. */
+
+typedef struct memfile_buffer_s {
+    uint8_t *data;
+    size_t size;     /* bytes in use */
+    size_t alloc;    /* bytes allocated, at least `size' */
+    int dirty;       /* written to since opened */
+} memfile_buffer_t;
+
+#ifdef USE_LIBRETRO_VFS
+struct retro_vfs_interface_info;
+void memfile_vfs_init(const struct retro_vfs_interface_info *vfs_info);
+#endif
+
+FILE *memfile_open(memfile_buffer_t *buf, const char *mode);
+
+/* Read-only mappings of whole files, where mmap() is available. Only files
+ * on the local file system can be mapped, NULL is returned for anything
+ * else and the caller goes through the stream instead. */
+const uint8_t *memfile_map(const char *path, size_t *size);
+void memfile_unmap(const uint8_t *data, size_t size);
+
+#endif
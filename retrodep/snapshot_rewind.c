@@ -0,0 +1,505 @@
+#include "vice.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib.h"
+#include "log.h"
+#include "types.h"
+
+#include "snapshot_stream.h"
+#include "snapshot_rewind.h"
+
+/* Snapshot layout, see snapshot_create_from_stream() and
+   snapshot_module_create() */
+#define REWIND_SNAPSHOT_HEADER_LEN  (19 + 2 + SNAPSHOT_MACHINE_NAME_LEN + 13 + 4 + 4)
+#define REWIND_MODULE_HEADER_LEN    (SNAPSHOT_MODULE_NAME_LEN + 2 + 4)
+#define REWIND_MODULE_SIZE_OFFSET   (SNAPSHOT_MODULE_NAME_LEN + 2)
+
+#define REWIND_MAX_SEGMENTS         256
+
+/* Segment kinds in a delta record */
+#define REWIND_SEGMENT_XOR          0
+#define REWIND_SEGMENT_RAW          1
+
+/* Record framing: length before and after the payload, so the ring can be
+   walked from both ends */
+#define REWIND_RECORD_OVERHEAD      (2 * sizeof(uint32_t))
+
+typedef struct rewind_segment_s {
+    size_t offset;
+    size_t size;
+} rewind_segment_t;
+
+static log_t rewind_log = LOG_DEFAULT;
+
+/* Ring of delta records */
+static uint8_t *ring = NULL;
+static size_t ring_size = 0;
+static size_t ring_head = 0;
+static size_t ring_tail = 0;
+static size_t ring_used = 0;
+static unsigned int ring_count = 0;
+
+/* Most recent full snapshot */
+static uint8_t *current = NULL;
+static size_t current_size = 0;
+static size_t current_alloc = 0;
+
+/* Work buffers for encoding and decoding */
+static uint8_t *work = NULL;
+static size_t work_alloc = 0;
+static uint8_t *prev = NULL;
+static size_t prev_alloc = 0;
+
+static rewind_segment_t segments_state[REWIND_MAX_SEGMENTS];
+static rewind_segment_t segments_ref[REWIND_MAX_SEGMENTS];
+
+/* ------------------------------------------------------------------------- */
+
+static void rewind_reserve(uint8_t **buffer, size_t *alloc, size_t size)
+{
+    if (*alloc < size) {
+        *buffer = lib_realloc(*buffer, size);
+        *alloc = size;
+    }
+}
+
+static uint32_t rewind_get_dword(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void rewind_put_dword(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static size_t rewind_put_varint(uint8_t *p, size_t value)
+{
+    size_t len = 0;
+
+    while (value >= 0x80) {
+        p[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    p[len++] = (uint8_t)value;
+    return len;
+}
+
+static const uint8_t *rewind_get_varint(const uint8_t *p, const uint8_t *end, size_t *value)
+{
+    size_t result = 0;
+    unsigned int shift = 0;
+
+    while (p < end) {
+        uint8_t b = *p++;
+        result |= (size_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *value = result;
+            return p;
+        }
+        shift += 7;
+    }
+    return NULL;
+}
+
+/* Split a snapshot image into the file header and its modules. Falls back
+   to a single segment if the image does not parse. */
+static unsigned int rewind_split(const uint8_t *state, size_t size, rewind_segment_t *segments)
+{
+    unsigned int count = 0;
+    size_t offset = REWIND_SNAPSHOT_HEADER_LEN;
+
+    if (size < REWIND_SNAPSHOT_HEADER_LEN) {
+        goto fallback;
+    }
+
+    segments[count].offset = 0;
+    segments[count].size = REWIND_SNAPSHOT_HEADER_LEN;
+    count++;
+
+    while (offset < size) {
+        size_t module_size;
+
+        if (count == REWIND_MAX_SEGMENTS || size - offset < REWIND_MODULE_HEADER_LEN) {
+            goto fallback;
+        }
+        module_size = rewind_get_dword(state + offset + REWIND_MODULE_SIZE_OFFSET);
+        if (module_size < REWIND_MODULE_HEADER_LEN || module_size > size - offset) {
+            goto fallback;
+        }
+        segments[count].offset = offset;
+        segments[count].size = module_size;
+        count++;
+        offset += module_size;
+    }
+    return count;
+
+fallback:
+    segments[0].offset = 0;
+    segments[0].size = size;
+    return 1;
+}
+
+/* Find the segment of `ref' that `seg' can be XORed against: same size and,
+   for modules, same name. The same index is tried first since the layout
+   rarely changes between two frames. */
+static int rewind_match(const uint8_t *state, const rewind_segment_t *seg, unsigned int index,
+                        const uint8_t *ref, const rewind_segment_t *ref_segments, unsigned int ref_count)
+{
+    unsigned int i;
+    size_t name_len = (seg->offset == 0) ? 0 : SNAPSHOT_MODULE_NAME_LEN;
+
+    if (index < ref_count
+        && ref_segments[index].size == seg->size
+        && memcmp(ref + ref_segments[index].offset, state + seg->offset, name_len) == 0) {
+        return (int)index;
+    }
+    for (i = 0; i < ref_count; i++) {
+        if (ref_segments[i].size == seg->size
+            && (ref_segments[i].offset == 0) == (seg->offset == 0)
+            && memcmp(ref + ref_segments[i].offset, state + seg->offset, name_len) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/* Encode `a ^ b' as runs of unchanged bytes followed by runs of XORed
+   literals. Returns the encoded length. */
+static size_t rewind_encode_xor(uint8_t *out, const uint8_t *a, const uint8_t *b, size_t size)
+{
+    size_t pos = 0;
+    size_t len = 0;
+
+    while (pos < size) {
+        size_t skip = pos;
+        size_t lit;
+
+        /* Unchanged areas dominate in large memories, compare those a
+           word at a time */
+        while (size - pos >= sizeof(uint64_t)) {
+            uint64_t wa, wb;
+
+            memcpy(&wa, a + pos, sizeof(wa));
+            memcpy(&wb, b + pos, sizeof(wb));
+            if (wa != wb) {
+                break;
+            }
+            pos += sizeof(uint64_t);
+        }
+        while (pos < size && a[pos] == b[pos]) {
+            pos++;
+        }
+        skip = pos - skip;
+
+        lit = pos;
+        /* Short equal runs inside a changed area are cheaper as literals */
+        while (pos < size && (a[pos] != b[pos]
+                              || (pos + 1 < size && a[pos + 1] != b[pos + 1])
+                              || (pos + 2 < size && a[pos + 2] != b[pos + 2]))) {
+            pos++;
+        }
+        lit = pos - lit;
+
+        len += rewind_put_varint(out + len, skip);
+        len += rewind_put_varint(out + len, lit);
+        for (; lit > 0; lit--) {
+            size_t i = pos - lit;
+            out[len++] = a[i] ^ b[i];
+        }
+    }
+    return len;
+}
+
+static const uint8_t *rewind_decode_xor(uint8_t *out, const uint8_t *ref, size_t size,
+                                        const uint8_t *p, const uint8_t *end)
+{
+    size_t pos = 0;
+
+    memcpy(out, ref, size);
+    while (pos < size) {
+        size_t skip, lit;
+
+        if ((p = rewind_get_varint(p, end, &skip)) == NULL
+            || (p = rewind_get_varint(p, end, &lit)) == NULL
+            || skip > size - pos || lit > size - pos - skip || lit > (size_t)(end - p)) {
+            return NULL;
+        }
+        pos += skip;
+        for (; lit > 0; lit--) {
+            out[pos++] ^= *p++;
+        }
+    }
+    return p;
+}
+
+/* Build the record that turns `ref' back into `state' */
+static size_t rewind_encode(uint8_t *out, const uint8_t *state, size_t size,
+                            const uint8_t *ref, size_t ref_size)
+{
+    unsigned int count, ref_count, i;
+    size_t len = 0;
+
+    count = rewind_split(state, size, segments_state);
+    ref_count = rewind_split(ref, ref_size, segments_ref);
+
+    rewind_put_dword(out, (uint32_t)size);
+    len += sizeof(uint32_t);
+
+    for (i = 0; i < count; i++) {
+        const rewind_segment_t *seg = &segments_state[i];
+        int match = rewind_match(state, seg, i, ref, segments_ref, ref_count);
+
+        if (match >= 0) {
+            out[len++] = REWIND_SEGMENT_XOR;
+            len += rewind_put_varint(out + len, seg->size);
+            len += rewind_put_varint(out + len, segments_ref[match].offset);
+            len += rewind_encode_xor(out + len, state + seg->offset,
+                                     ref + segments_ref[match].offset, seg->size);
+        } else {
+            out[len++] = REWIND_SEGMENT_RAW;
+            len += rewind_put_varint(out + len, seg->size);
+            memcpy(out + len, state + seg->offset, seg->size);
+            len += seg->size;
+        }
+    }
+    return len;
+}
+
+static int rewind_decode(uint8_t *out, size_t size, const uint8_t *p, const uint8_t *end,
+                         const uint8_t *ref, size_t ref_size)
+{
+    size_t pos = 0;
+
+    while (pos < size) {
+        uint8_t kind;
+        size_t seg_size, ref_offset;
+
+        if (p >= end) {
+            return -1;
+        }
+        kind = *p++;
+        if ((p = rewind_get_varint(p, end, &seg_size)) == NULL || seg_size > size - pos) {
+            return -1;
+        }
+        if (kind == REWIND_SEGMENT_XOR) {
+            if ((p = rewind_get_varint(p, end, &ref_offset)) == NULL
+                || ref_offset > ref_size || seg_size > ref_size - ref_offset
+                || (p = rewind_decode_xor(out + pos, ref + ref_offset, seg_size, p, end)) == NULL) {
+                return -1;
+            }
+        } else {
+            if (seg_size > (size_t)(end - p)) {
+                return -1;
+            }
+            memcpy(out + pos, p, seg_size);
+            p += seg_size;
+        }
+        pos += seg_size;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void ring_write(size_t offset, const uint8_t *data, size_t size)
+{
+    size_t first = ring_size - offset;
+
+    if (first >= size) {
+        memcpy(ring + offset, data, size);
+    } else {
+        memcpy(ring + offset, data, first);
+        memcpy(ring, data + first, size - first);
+    }
+}
+
+static void ring_read(size_t offset, uint8_t *data, size_t size)
+{
+    size_t first = ring_size - offset;
+
+    if (first >= size) {
+        memcpy(data, ring + offset, size);
+    } else {
+        memcpy(data, ring + offset, first);
+        memcpy(data + first, ring, size - first);
+    }
+}
+
+static size_t ring_wrap(size_t offset)
+{
+    return (offset >= ring_size) ? offset - ring_size : offset;
+}
+
+/* Forget the oldest record */
+static void ring_drop(void)
+{
+    uint8_t len[sizeof(uint32_t)];
+    size_t record;
+
+    ring_read(ring_tail, len, sizeof(len));
+    record = rewind_get_dword(len) + REWIND_RECORD_OVERHEAD;
+    ring_tail = ring_wrap(ring_tail + record);
+    ring_used -= record;
+    ring_count--;
+}
+
+static void ring_push(const uint8_t *payload, size_t size)
+{
+    uint8_t len[sizeof(uint32_t)];
+    size_t record = size + REWIND_RECORD_OVERHEAD;
+
+    while (ring_size - ring_used < record) {
+        ring_drop();
+    }
+
+    rewind_put_dword(len, (uint32_t)size);
+    ring_write(ring_head, len, sizeof(len));
+    ring_write(ring_wrap(ring_head + sizeof(len)), payload, size);
+    ring_write(ring_wrap(ring_head + sizeof(len) + size), len, sizeof(len));
+    ring_head = ring_wrap(ring_head + record);
+    ring_used += record;
+    ring_count++;
+}
+
+/* Take the newest record off the ring into `work' */
+static size_t ring_pop(void)
+{
+    uint8_t len[sizeof(uint32_t)];
+    size_t size, record;
+
+    ring_read(ring_wrap(ring_head + ring_size - sizeof(len)), len, sizeof(len));
+    size = rewind_get_dword(len);
+    record = size + REWIND_RECORD_OVERHEAD;
+
+    rewind_reserve(&work, &work_alloc, size);
+    ring_read(ring_wrap(ring_head + ring_size - record + sizeof(len)), work, size);
+    ring_head = ring_wrap(ring_head + ring_size - record);
+    ring_used -= record;
+    ring_count--;
+    return size;
+}
+
+/* ------------------------------------------------------------------------- */
+
+int snapshot_rewind_init(size_t budget)
+{
+    if (rewind_log == LOG_DEFAULT) {
+        rewind_log = log_open("Rewind");
+    }
+
+    if (budget == ring_size) {
+        return 0;
+    }
+
+    snapshot_rewind_shutdown();
+    if (budget == 0) {
+        return 0;
+    }
+
+    ring = lib_malloc(budget);
+    if (ring == NULL) {
+        log_error(rewind_log, "Cannot allocate %lu bytes for rewind.", (unsigned long)budget);
+        return -1;
+    }
+    ring_size = budget;
+    snapshot_rewind_reset();
+    return 0;
+}
+
+void snapshot_rewind_shutdown(void)
+{
+    lib_free(ring);
+    lib_free(current);
+    lib_free(work);
+    lib_free(prev);
+    ring = current = work = prev = NULL;
+    ring_size = current_alloc = work_alloc = prev_alloc = 0;
+    snapshot_rewind_reset();
+}
+
+void snapshot_rewind_reset(void)
+{
+    ring_head = ring_tail = ring_used = 0;
+    ring_count = 0;
+    current_size = 0;
+}
+
+/* Store `state' as the newest snapshot, turning the previous newest one into
+   a delta record against it */
+int snapshot_rewind_push(const uint8_t *state, size_t size)
+{
+    if (ring == NULL || size == 0) {
+        return -1;
+    }
+
+    if (current_size > 0) {
+        size_t len;
+
+        /* Worst case is every segment raw plus its framing */
+        rewind_reserve(&work, &work_alloc, current_size + 32 * REWIND_MAX_SEGMENTS + sizeof(uint32_t));
+        len = rewind_encode(work, current, current_size, state, size);
+        if (len + REWIND_RECORD_OVERHEAD <= ring_size) {
+            ring_push(work, len);
+        } else {
+            /* Does not fit at all, history starts over from this state */
+            snapshot_rewind_reset();
+        }
+    }
+
+    rewind_reserve(&current, &current_alloc, size);
+    memcpy(current, state, size);
+    current_size = size;
+    return 0;
+}
+
+/* Step back one snapshot. The oldest one is returned again once the ring
+   has been used up. */
+size_t snapshot_rewind_pop(const uint8_t **state)
+{
+    *state = NULL;
+    if (current_size == 0) {
+        return 0;
+    }
+
+    if (ring_count > 0) {
+        size_t len = ring_pop();
+        size_t size;
+        uint8_t *swap;
+
+        if (len < sizeof(uint32_t)) {
+            goto fail;
+        }
+        size = rewind_get_dword(work);
+        rewind_reserve(&prev, &prev_alloc, size);
+        if (rewind_decode(prev, size, work + sizeof(uint32_t), work + len, current, current_size) < 0) {
+            goto fail;
+        }
+
+        swap = current;
+        current = prev;
+        prev = swap;
+        len = current_alloc;
+        current_alloc = prev_alloc;
+        prev_alloc = len;
+        current_size = size;
+    }
+
+    *state = current;
+    return current_size;
+
+fail:
+    log_error(rewind_log, "Corrupt rewind record, history dropped.");
+    snapshot_rewind_reset();
+    return 0;
+}
+
+unsigned int snapshot_rewind_count(void)
+{
+    return ring_count;
+}
@@ -0,0 +1,25 @@
+#ifndef SNAPSHOT_REWIND_H
+#define SNAPSHOT_REWIND_H
+
+#include <stddef.h>
+
+#include "types.h"
+
+/* Core side rewind ring.
+ *
+ * Only the most recent snapshot is kept as a full image, every older one is
+ * stored as a backward delta against its successor. Deltas follow the
+ * snapshot module boundaries, so unchanged modules cost a few bytes and a
+ * module that changed size is simply stored raw. The ring lives in a fixed
+ * budget and forgets the oldest deltas when it runs full. */
+
+int snapshot_rewind_init(size_t budget);
+void snapshot_rewind_shutdown(void);
+void snapshot_rewind_reset(void);
+
+int snapshot_rewind_push(const uint8_t *state, size_t size);
+size_t snapshot_rewind_pop(const uint8_t **state);
+
+unsigned int snapshot_rewind_count(void);
+
+#endif
@@ -135,6 +135,10 @@ struct snapshot_memory_stream_s {
 
     /* Stream size */
     size_t stream_size;
+
+    /* Incremental write: id of the previous image still in the buffer, 0 if
+       the buffer has to be written in full */
+    unsigned int incremental_id;
 };
 
 struct snapshot_module_s {
@@ -161,6 +165,10 @@ struct snapshot_s {
     /* Offset of the first module.  */
     long first_module_offset;
 
+    /* Offset of the module after the one opened last. Modules are mostly
+       read in the order they were written, so searching starts here.  */
+    long next_module_offset;
+
     /* Flag: are we writing it?  */
     int write_mode;
 };
@@ -441,6 +449,7 @@ snapshot_stream_t* snapshot_memory_write_fopen(void* buffer, size_t buffer_size)
     stream->buffer_size = buffer_size;
     stream->pointer = 0;
     stream->stream_size = 0;
+    stream->incremental_id = 0;
     stream->istream.ops = &snapshot_memory_ops;
     return &stream->istream;
 
@@ -460,6 +469,7 @@ snapshot_stream_t* snapshot_memory_read_fopen(const void* buffer, size_t buffer_
     stream->buffer_size = buffer_size;
     stream->pointer = 0;
     stream->stream_size = buffer_size;
+    stream->incremental_id = 0;
     stream->istream.ops = &snapshot_memory_ops;
     return &stream->istream;
 
@@ -467,21 +477,54 @@ fail:
     return NULL;
 }
 
+/* Write into a buffer that still holds the image written with the same `id'.
+   Blocks saved with snapshot_module_write_dirty_byte_array() then only copy
+   the pages that changed since. The caller has to pick a new id whenever the
+   buffer content is no longer that image. */
+snapshot_stream_t* snapshot_memory_write_incremental_fopen(void* buffer, size_t buffer_size, unsigned int id)
+{
+    snapshot_stream_t* f = snapshot_memory_write_fopen(buffer, buffer_size);
+
+    if (f != NULL && buffer != NULL) {
+        container_of(f, snapshot_memory_stream_t, istream)->incremental_id = id;
+    }
+    return f;
+}
+
+static unsigned int snapshot_incremental_id(snapshot_stream_t *f)
+{
+    if (f->ops != &snapshot_memory_ops) {
+        return 0;
+    }
+    return container_of(f, snapshot_memory_stream_t, istream)->incremental_id;
+}
+
 
 /* ------------------------------------------------------------------------- */
 
+/* Memory streams are called directly so the compiler can inline them, they
+   are what serializing for libretro uses on every frame */
 size_t snapshot_read(snapshot_stream_t* f, void* ptr, size_t size)
 {
+    if (f->ops == &snapshot_memory_ops) {
+        return snapshot_memory_read(f, ptr, size);
+    }
     return f->ops->read(f, ptr, size);
 }
 
 size_t snapshot_write(snapshot_stream_t* f, const void* ptr, size_t size)
 {
+    if (f->ops == &snapshot_memory_ops) {
+        return snapshot_memory_write(f, ptr, size);
+    }
     return f->ops->write(f, ptr, size);
 }
 
 long snapshot_ftell(snapshot_stream_t *f)
 {
+    if (f->ops == &snapshot_memory_ops) {
+        return snapshot_memory_ftell(f);
+    }
     return f->ops->tell(f);
 }
 
@@ -511,60 +554,71 @@ static const char* snapshot_filename(snapshot_stream_t *f)
 
 /* ------------------------------------------------------------------------- */
 
-static int snapshot_write_byte(snapshot_stream_t *f, uint8_t data)
+/* Scalars and arrays are converted to little endian in a local buffer and
+   handed to the stream in one call. Run-ahead saves and loads a state every
+   frame, so the per byte stream calls used to dominate. */
+#define SNAPSHOT_CHUNK_SIZE 256
+
+static void snapshot_put_le(uint8_t *p, uint64_t data, unsigned int size)
 {
-    current_fpos = snapshot_ftell(f);
-    if (snapshot_write(f, &data, 1) != 1) {
-        snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
-        return -1;
+    unsigned int i;
+
+    for (i = 0; i < size; i++) {
+        p[i] = (uint8_t)(data >> (i * 8));
     }
+}
 
-    return 0;
+static uint64_t snapshot_get_le(const uint8_t *p, unsigned int size)
+{
+    uint64_t data = 0;
+    unsigned int i;
+
+    for (i = 0; i < size; i++) {
+        data |= (uint64_t)p[i] << (i * 8);
+    }
+    return data;
 }
 
-static int snapshot_write_word(snapshot_stream_t *f, uint16_t data)
+static int snapshot_write_le(snapshot_stream_t *f, uint64_t data, unsigned int size)
 {
+    uint8_t buf[sizeof(uint64_t)];
+
     current_fpos = snapshot_ftell(f);
-    if (snapshot_write_byte(f, (uint8_t)(data & 0xff)) < 0
-        || snapshot_write_byte(f, (uint8_t)(data >> 8)) < 0) {
+    snapshot_put_le(buf, data, size);
+    if (snapshot_write(f, buf, size) != 1) {
+        snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
         return -1;
     }
 
     return 0;
 }
 
-static int snapshot_write_dword(snapshot_stream_t *f, uint32_t data)
+static int snapshot_write_byte(snapshot_stream_t *f, uint8_t data)
 {
-    current_fpos = snapshot_ftell(f);
-    if (snapshot_write_word(f, (uint16_t)(data & 0xffff)) < 0
-        || snapshot_write_word(f, (uint16_t)(data >> 16)) < 0) {
-        return -1;
-    }
+    return snapshot_write_le(f, data, sizeof(uint8_t));
+}
 
-    return 0;
+static int snapshot_write_word(snapshot_stream_t *f, uint16_t data)
+{
+    return snapshot_write_le(f, data, sizeof(uint16_t));
 }
 
-static int snapshot_write_qword(snapshot_stream_t *f, uint64_t data)
+static int snapshot_write_dword(snapshot_stream_t *f, uint32_t data)
 {
-    current_fpos = snapshot_ftell(f);
-    if (snapshot_write_dword(f, (uint32_t)(data & 0xffffffff)) < 0
-        || snapshot_write_dword(f, (uint32_t)(data >> 32)) < 0) {
-        return -1;
-    }
+    return snapshot_write_le(f, data, sizeof(uint32_t));
+}
 
-    return 0;
+static int snapshot_write_qword(snapshot_stream_t *f, uint64_t data)
+{
+    return snapshot_write_le(f, data, sizeof(uint64_t));
 }
 
 static int snapshot_write_double(snapshot_stream_t *f, double data)
 {
-    uint8_t *byte_data = (uint8_t *)&data;
-    int i;
-
     current_fpos = snapshot_ftell(f);
-    for (i = 0; i < sizeof(double); i++) {
-        if (snapshot_write_byte(f, byte_data[i]) < 0) {
-            return -1;
-        }
+    if (snapshot_write(f, &data, sizeof(double)) != 1) {
+        snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
+        return -1;
     }
     return 0;
 }
@@ -572,17 +626,21 @@ static int snapshot_write_double(snapshot_stream_t *f, double data)
 static int snapshot_write_padded_string(snapshot_stream_t *f, const char *s, uint8_t pad_char,
                                         int len)
 {
-    int i, found_zero;
-    uint8_t c;
+    uint8_t buf[SNAPSHOT_CHUNK_SIZE];
+    int i, n, found_zero;
 
     current_fpos = snapshot_ftell(f);
-    for (i = found_zero = 0; i < len; i++) {
+    for (i = n = found_zero = 0; i < len; i++) {
         if (!found_zero && s[i] == 0) {
             found_zero = 1;
         }
-        c = found_zero ? (uint8_t)pad_char : (uint8_t) s[i];
-        if (snapshot_write_byte(f, c) < 0) {
-            return -1;
+        buf[n++] = found_zero ? (uint8_t)pad_char : (uint8_t) s[i];
+        if (n == SNAPSHOT_CHUNK_SIZE || i == len - 1) {
+            if (snapshot_write(f, buf, (size_t)n) != 1) {
+                snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
+                return -1;
+            }
+            n = 0;
         }
     }
 
@@ -602,12 +660,19 @@ static int snapshot_write_byte_array(snapshot_stream_t *f, const uint8_t *data,
 
 static int snapshot_write_word_array(snapshot_stream_t *f, const uint16_t *data, unsigned int num)
 {
-    unsigned int i;
+    uint8_t buf[SNAPSHOT_CHUNK_SIZE];
+    unsigned int i, n;
 
     current_fpos = snapshot_ftell(f);
-    for (i = 0; i < num; i++) {
-        if (snapshot_write_word(f, data[i]) < 0) {
-            return -1;
+    for (i = n = 0; i < num; i++) {
+        snapshot_put_le(buf + n, data[i], sizeof(uint16_t));
+        n += sizeof(uint16_t);
+        if (n == SNAPSHOT_CHUNK_SIZE || i == num - 1) {
+            if (snapshot_write(f, buf, n) != 1) {
+                snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
+                return -1;
+            }
+            n = 0;
         }
     }
 
@@ -616,12 +681,19 @@ static int snapshot_write_word_array(snapshot_stream_t *f, const uint16_t *data,
 
 static int snapshot_write_dword_array(snapshot_stream_t *f, const uint32_t *data, unsigned int num)
 {
-    unsigned int i;
+    uint8_t buf[SNAPSHOT_CHUNK_SIZE];
+    unsigned int i, n;
 
     current_fpos = snapshot_ftell(f);
-    for (i = 0; i < num; i++) {
-        if (snapshot_write_dword(f, data[i]) < 0) {
-            return -1;
+    for (i = n = 0; i < num; i++) {
+        snapshot_put_le(buf + n, data[i], sizeof(uint32_t));
+        n += sizeof(uint32_t);
+        if (n == SNAPSHOT_CHUNK_SIZE || i == num - 1) {
+            if (snapshot_write(f, buf, n) != 1) {
+                snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
+                return -1;
+            }
+            n = 0;
         }
     }
 
@@ -649,72 +721,65 @@ static int snapshot_write_string(snapshot_stream_t *f, const char *s)
     return (int)(len + sizeof(uint16_t));
 }
 
-static int snapshot_read_byte(snapshot_stream_t *f, uint8_t *b_return)
+static int snapshot_read_le(snapshot_stream_t *f, uint64_t *data, unsigned int size)
 {
-    uint8_t b;
+    uint8_t buf[sizeof(uint64_t)];
 
     current_fpos = snapshot_ftell(f);
-    if (snapshot_read(f, &b, 1) != 1) {
+    if (snapshot_read(f, buf, size) != 1) {
         snapshot_error = SNAPSHOT_READ_EOF_ERROR;
         return -1;
     }
-    *b_return = b;
+    *data = snapshot_get_le(buf, size);
     return 0;
 }
 
-static int snapshot_read_word(snapshot_stream_t *f, uint16_t *w_return)
+static int snapshot_read_byte(snapshot_stream_t *f, uint8_t *b_return)
 {
-    uint8_t lo, hi;
+    uint64_t data;
 
-    current_fpos = snapshot_ftell(f);
-    if (snapshot_read_byte(f, &lo) < 0 || snapshot_read_byte(f, &hi) < 0) {
+    if (snapshot_read_le(f, &data, sizeof(uint8_t)) < 0) {
         return -1;
     }
-
-    *w_return = lo | (hi << 8);
+    *b_return = (uint8_t)data;
     return 0;
 }
 
-static int snapshot_read_dword(snapshot_stream_t *f, uint32_t *dw_return)
+static int snapshot_read_word(snapshot_stream_t *f, uint16_t *w_return)
 {
-    uint16_t lo, hi;
+    uint64_t data;
 
-    current_fpos = snapshot_ftell(f);
-    if (snapshot_read_word(f, &lo) < 0 || snapshot_read_word(f, &hi) < 0) {
+    if (snapshot_read_le(f, &data, sizeof(uint16_t)) < 0) {
         return -1;
     }
-
-    *dw_return = lo | (hi << 16);
+    *w_return = (uint16_t)data;
     return 0;
 }
 
-static int snapshot_read_qword(snapshot_stream_t *f, uint64_t *qw_return)
+static int snapshot_read_dword(snapshot_stream_t *f, uint32_t *dw_return)
 {
-    uint32_t lo, hi;
+    uint64_t data;
 
-    current_fpos = snapshot_ftell(f);
-    if (snapshot_read_dword(f, &lo) < 0 || snapshot_read_dword(f, &hi) < 0) {
+    if (snapshot_read_le(f, &data, sizeof(uint32_t)) < 0) {
         return -1;
     }
-
-    *qw_return = lo | ((uint64_t)hi << 32);
+    *dw_return = (uint32_t)data;
     return 0;
 }
 
+static int snapshot_read_qword(snapshot_stream_t *f, uint64_t *qw_return)
+{
+    return snapshot_read_le(f, qw_return, sizeof(uint64_t));
+}
+
 static int snapshot_read_double(snapshot_stream_t *f, double *d_return)
 {
-    int i;
-    uint8_t b;
     double val;
-    uint8_t *byte_val = (uint8_t *)&val;
 
     current_fpos = snapshot_ftell(f);
-    for (i = 0; i < sizeof(double); i++) {
-        if (snapshot_read(f, &b, 1) != 1) {
-            snapshot_error = SNAPSHOT_READ_EOF_ERROR;
-            return -1;
-        }
-        byte_val[i] = b;
+    if (snapshot_read(f, &val, sizeof(double)) != 1) {
+        snapshot_error = SNAPSHOT_READ_EOF_ERROR;
+        return -1;
     }
     *d_return = val;
     return 0;
@@ -733,13 +798,20 @@ static int snapshot_read_byte_array(snapshot_stream_t *f, uint8_t *b_return, uns
 
 static int snapshot_read_word_array(snapshot_stream_t *f, uint16_t *w_return, unsigned int num)
 {
-    unsigned int i;
+    uint8_t buf[SNAPSHOT_CHUNK_SIZE];
+    unsigned int i, n;
 
     current_fpos = snapshot_ftell(f);
-    for (i = 0; i < num; i++) {
-        if (snapshot_read_word(f, w_return + i) < 0) {
+    while (num > 0) {
+        n = (num < SNAPSHOT_CHUNK_SIZE / sizeof(uint16_t)) ? num : SNAPSHOT_CHUNK_SIZE / sizeof(uint16_t);
+        if (snapshot_read(f, buf, n * sizeof(uint16_t)) != 1) {
+            snapshot_error = SNAPSHOT_READ_EOF_ERROR;
             return -1;
         }
+        for (i = 0; i < n; i++) {
+            *w_return++ = (uint16_t)snapshot_get_le(buf + i * sizeof(uint16_t), sizeof(uint16_t));
+        }
+        num -= n;
     }
 
     return 0;
@@ -747,13 +819,20 @@ static int snapshot_read_word_array(snapshot_stream_t *f, uint16_t *w_return, un
 
 static int snapshot_read_dword_array(snapshot_stream_t *f, uint32_t *dw_return, unsigned int num)
 {
-    unsigned int i;
+    uint8_t buf[SNAPSHOT_CHUNK_SIZE];
+    unsigned int i, n;
 
     current_fpos = snapshot_ftell(f);
-    for (i = 0; i < num; i++) {
-        if (snapshot_read_dword(f, dw_return + i) < 0) {
+    while (num > 0) {
+        n = (num < SNAPSHOT_CHUNK_SIZE / sizeof(uint32_t)) ? num : SNAPSHOT_CHUNK_SIZE / sizeof(uint32_t);
+        if (snapshot_read(f, buf, n * sizeof(uint32_t)) != 1) {
+            snapshot_error = SNAPSHOT_READ_EOF_ERROR;
             return -1;
         }
+        for (i = 0; i < n; i++) {
+            *dw_return++ = (uint32_t)snapshot_get_le(buf + i * sizeof(uint32_t), sizeof(uint32_t));
+        }
+        num -= n;
     }
 
     return 0;
@@ -863,6 +942,53 @@ int snapshot_module_write_byte_array(snapshot_module_t *m, const uint8_t *b, uns
     return 0;
 }
 
+/* Like snapshot_module_write_byte_array(), but on an incremental stream the
+   pages `map' has not seen a store to are skipped. They still hold the bytes
+   of the previous write, provided the block sits at the same offset. */
+int snapshot_module_write_dirty_byte_array(snapshot_module_t *m, const uint8_t *b, unsigned int num, dirty_map_t *map)
+{
+    unsigned int id = snapshot_incremental_id(m->file);
+    long offset;
+
+    if (id == 0 || map->pages == NULL) {
+        return snapshot_module_write_byte_array(m, b, num);
+    }
+
+    offset = snapshot_ftell(m->file);
+    if (map->checkpoint_id != id || map->checkpoint_offset != offset || map->checkpoint_size != num) {
+        if (snapshot_module_write_byte_array(m, b, num) < 0) {
+            map->checkpoint_id = 0;
+            return -1;
+        }
+    } else {
+        unsigned int page = 0;
+
+        while (page < map->num_pages) {
+            uint8_t dirty = map->pages[page];
+            unsigned int start = page << map->page_shift;
+            unsigned int end;
+
+            while (page < map->num_pages && map->pages[page] == dirty) {
+                page++;
+            }
+            end = page << map->page_shift;
+            if (end > num) {
+                end = num;
+            }
+            if (start < end && snapshot_module_write_byte_array(m, dirty ? b + start : NULL, end - start) < 0) {
+                map->checkpoint_id = 0;
+                return -1;
+            }
+        }
+    }
+
+    dirty_map_clear(map);
+    map->checkpoint_id = id;
+    map->checkpoint_offset = offset;
+    map->checkpoint_size = num;
+    return 0;
+}
+
 int snapshot_module_write_word_array(snapshot_module_t *m, const uint16_t *w, unsigned int num)
 {
     if (snapshot_write_word_array(m->file, w, num) < 0) {
@@ -1116,53 +1242,66 @@ snapshot_module_t *snapshot_module_create(snapshot_t *s, const char *name, uint8
     return m;
 }
 
-snapshot_module_t *snapshot_module_open(snapshot_t *s, const char *name, uint8_t *major_version_return, uint8_t *minor_version_return)
+/* Walk the module headers from `start' until `name' is found or `stop' is
+   reached (-1 to search to the end).  */
+static int snapshot_module_find(snapshot_t *s, snapshot_module_t *m, const char *name, long start, long stop,
+                                uint8_t *major_version_return, uint8_t *minor_version_return)
 {
-    snapshot_module_t *m;
     char n[SNAPSHOT_MODULE_NAME_LEN];
     unsigned int name_len = (unsigned int)strlen(name);
 
-    current_module = (char *)name;
-
-    if (snapshot_fseek(s->file, s->first_module_offset, SEEK_SET) < 0) {
-        snapshot_error = SNAPSHOT_FIRST_MODULE_NOT_FOUND_ERROR;
-        DBG(("snapshot_module_open error: name: '%s' NOT found", name));
-        return NULL;
-    }
-
-    m = lib_malloc(sizeof(snapshot_module_t));
-    m->file = s->file;
-    m->write_mode = 0;
-
-    m->offset = s->first_module_offset;
-
-    DBG(("snapshot_module_open name: '%s'", name));
+    m->offset = start;
+    while (stop < 0 || m->offset < stop) {
+        if (snapshot_fseek(s->file, m->offset, SEEK_SET) < 0) {
+            snapshot_error = SNAPSHOT_MODULE_NOT_FOUND_ERROR;
+            return -1;
+        }
 
-    /* Search for the module name.  This is quite inefficient, but I don't
-       think we care.  */
-    while (1) {
         if (snapshot_read_byte_array(s->file, (uint8_t *)n,
                                      SNAPSHOT_MODULE_NAME_LEN) < 0
             || snapshot_read_byte(s->file, major_version_return) < 0
             || snapshot_read_byte(s->file, minor_version_return) < 0
-            || snapshot_read_dword(s->file, &m->size)) {
+            || snapshot_read_dword(s->file, &m->size)
+            || m->size == 0) {
             snapshot_error = SNAPSHOT_MODULE_HEADER_READ_ERROR;
-            goto fail;
+            return -1;
         }
 
         /* Found?  */
         if (memcmp(n, name, name_len) == 0
             && (name_len == SNAPSHOT_MODULE_NAME_LEN || n[name_len] == 0)) {
-            break;
+            return 0;
         }
 
         m->offset += m->size;
-        if (snapshot_fseek(s->file, m->offset, SEEK_SET) < 0) {
-            snapshot_error = SNAPSHOT_MODULE_NOT_FOUND_ERROR;
-            goto fail;
-        }
     }
 
+    snapshot_error = SNAPSHOT_MODULE_NOT_FOUND_ERROR;
+    return -1;
+}
+
+snapshot_module_t *snapshot_module_open(snapshot_t *s, const char *name, uint8_t *major_version_return, uint8_t *minor_version_return)
+{
+    snapshot_module_t *m;
+
+    current_module = (char *)name;
+
+    m = lib_malloc(sizeof(snapshot_module_t));
+    m->file = s->file;
+    m->write_mode = 0;
+
+    DBG(("snapshot_module_open name: '%s'", name));
+
+    /* Search from the module after the last one, then wrap around.  */
+    if (snapshot_module_find(s, m, name, s->next_module_offset, -1,
+                             major_version_return, minor_version_return) < 0
+        && (s->next_module_offset == s->first_module_offset
+            || snapshot_module_find(s, m, name, s->first_module_offset, s->next_module_offset,
+                                    major_version_return, minor_version_return) < 0)) {
+        goto fail;
+    }
+
+    s->next_module_offset = m->offset + m->size;
     m->size_offset = snapshot_ftell(s->file) - sizeof(uint32_t);
     DBG(("snapshot_module_open name: '%s', version %u.%u found", name, *major_version_return, *minor_version_return));
     return m;
@@ -1251,6 +1390,7 @@ snapshot_t *snapshot_create_from_stream(snapshot_stream_t *f, uint8_t major_vers
     s = lib_malloc(sizeof(snapshot_t));
     s->file = f;
     s->first_module_offset = snapshot_ftell(f);
+    s->next_module_offset = s->first_module_offset;
     s->write_mode = 1;
 
     return s;
@@ -1342,6 +1482,7 @@ snapshot_t *snapshot_open_from_stream(snapshot_stream_t *f, uint8_t *major_versi
     s = lib_malloc(sizeof(snapshot_t));
     s->file = f;
     s->first_module_offset = snapshot_ftell(f);
+    s->next_module_offset = s->first_module_offset;
     s->write_mode = 0;
 
     vsync_suspend_speed_eval();
@@ -2,6 +2,7 @@
 #define SNAPSHOT_STREAM_H
 
 #include "types.h"
+#include "dirtymap.h"
 
 #define SNAPSHOT_MACHINE_NAME_LEN       16
 #define SNAPSHOT_MODULE_NAME_LEN        16
@@ -52,6 +53,7 @@ int snapshot_module_write_qword(snapshot_module_t *m, uint64_t data);
 int snapshot_module_write_double(snapshot_module_t *m, double db);
 int snapshot_module_write_padded_string(snapshot_module_t *m, const char *s, uint8_t pad_char, int len);
 int snapshot_module_write_byte_array(snapshot_module_t *m, const uint8_t *data, unsigned int num);
+int snapshot_module_write_dirty_byte_array(snapshot_module_t *m, const uint8_t *data, unsigned int num, dirty_map_t *map);
 int snapshot_module_write_word_array(snapshot_module_t *m, const uint16_t *data, unsigned int num);
 int snapshot_module_write_dword_array(snapshot_module_t *m, const uint32_t *data, unsigned int num);
 int snapshot_module_write_string(snapshot_module_t *m, const char *s);
@@ -81,6 +83,7 @@ int snapshot_module_read_qword_into_int64(snapshot_module_t *m, int64_t *value_r
 #define SMW_DB       snapshot_module_write_double
 #define SMW_PSTR     snapshot_module_write_padded_string
 #define SMW_BA       snapshot_module_write_byte_array
+#define SMW_DBA      snapshot_module_write_dirty_byte_array
 #define SMW_WA       snapshot_module_write_word_array
 #define SMW_DWA      snapshot_module_write_dword_array
 #define SMW_STR      snapshot_module_write_string
@@ -135,6 +138,7 @@ snapshot_stream_t* snapshot_file_write_fopen(const char* pathname);
 
 snapshot_stream_t* snapshot_memory_read_fopen(const void* buffer, size_t buffer_size);
 snapshot_stream_t* snapshot_memory_write_fopen(void* buffer, size_t buffer_size);
+snapshot_stream_t* snapshot_memory_write_incremental_fopen(void* buffer, size_t buffer_size, unsigned int id);
 
 size_t snapshot_read(snapshot_stream_t* f, void* ptr, size_t size);
 size_t snapshot_write(snapshot_stream_t* f, const void* ptr, size_t size);
@@ -580,6 +580,10 @@ int ui_init_finalize(void)
    /* Printer */
    log_resources_set_int("Printer4", vice_opt.Printer);
 
+   /* Sampling profiler */
+   if (opt_profiler)
+      retro_profiler_set(opt_profiler);
+
    retro_ui_finalized = true;
    log_resource_set = true;
    return 0;
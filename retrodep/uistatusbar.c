@@ -281,6 +281,10 @@ void ui_display_paused(int flag)
 
 void ui_display_reset(int device, int mode)
 {
+    /* Cartridge attach and detach end up here */
+    if (device == 0) {
+        retro_snapshot_size_invalidate();
+    }
 }
 
 /* ----------------------------------------------------------------- */
@@ -384,6 +388,7 @@ void ui_display_drive_current_image(unsigned int unit_number, unsigned int drive
         drive_empty[unit_number] = 1;
 
     clear_drive_statusbar_chars(unit_number);
+    retro_snapshot_size_invalidate();
 
 #ifdef SDL_DEBUG
     fprintf(stderr, "%s\n", __func__);
@@ -455,6 +460,8 @@ void ui_display_tape_counter(int port, int counter)
 
 void ui_display_tape_current_image(int port, const char *image)
 {
+    retro_snapshot_size_invalidate();
+
 #ifdef SDL_DEBUG
     fprintf(stderr, "%s: %s\n", __func__, image);
 #endif
@@ -14,6 +14,8 @@
 #include "sound.h"
 #include "machine.h"
 #include "resources.h"
+#include "video-sound.h"
+#include "video-render.h"
 
 #include <math.h>
 #include <stdio.h>
@@ -119,8 +121,6 @@ int video_canvas_set_palette(struct video_canvas_s *canvas,
 static void video_canvas_crop(struct video_canvas_s *canvas)
 {
    unsigned i                  = 0;
-   unsigned j                  = 0;
-   unsigned color_diff         = 0;
    unsigned crop_height_max    = CROP_HEIGHT_MAX;
    unsigned crop_top_border    = CROP_TOP_BORDER;
    unsigned crop_bottom_border = CROP_TOP_BORDER + CROP_HEIGHT_MAX;
@@ -158,6 +158,9 @@ static void video_canvas_crop(struct video_canvas_s *canvas)
    vice_raster.blanked = 0;
 #endif
 
+   /* Raster content detection is only wanted by the scanning modes */
+   vice_raster.crop_xe = 0;
+
    /* Reset to maximum crop */
    vice_raster.first_line = (crop_id == 0 && crop_id != crop_id_prev) ? 0 : crop_top_border;
    vice_raster.last_line  = (crop_id == 0 && crop_id != crop_id_prev) ? retroh : vice_raster.first_line + crop_height_max;
@@ -169,42 +172,34 @@ static void video_canvas_crop(struct video_canvas_s *canvas)
       /* Accurate VIC-II requires different method for Auto-Disable */
       case CROP_AUTO_DISABLE:
 #endif
-         /* Pixel color per row must change, and border colors must
-          * differ in order to count as a show-worthy row, otherwise
-          * loaders with flashing borders would count as hits */
-         color_diff         = 1500 * pix_bytes;
          crop_bottom_border = crop_top_border + crop_height_max;
 
-         /* Top border, start from top */
+         /* Columns and rows for the raster to classify from now on. The
+          * bottom border may start a few rows higher below, or much higher
+          * on VDC, so leave room for that */
+         vice_raster.crop_canvas = canvas;
+         vice_raster.crop_xs     = crop_left_border + crop_pad;
+         vice_raster.crop_xe     = retrow - crop_left_border - crop_pad;
+         vice_raster.crop_lb     = crop_pad;
+         vice_raster.crop_rb     = retrow - crop_left_border;
+         vice_raster.crop_top    = crop_top_border;
+         vice_raster.crop_bottom = crop_bottom_border - 5;
+#if defined(__X128__)
+         if (c128_vdc)
+            vice_raster.crop_bottom -= crop_top_border;
+#endif
+
+         /* Top border, start from top. Rows are flagged by the raster while
+          * drawing: pixel color per row must change, and border colors must
+          * differ in order to count as a show-worthy row, otherwise
+          * loaders with flashing borders would count as hits */
          for (i = 0; i < crop_top_border && !vice_raster.blanked; i++)
          {
-            unsigned row      = i * (retrow << (pix_bytes >> 2));
-            unsigned color    = row + (crop_left_border + crop_pad) * (pix_bytes >> 1);
-            unsigned lb_color = row + crop_pad * (pix_bytes >> 1);
-            unsigned rb_color = row + (retrow - crop_left_border) * (pix_bytes >> 1);
-            unsigned found    = 0;
-
-            for (j = crop_left_border + crop_pad; j < retrow - crop_left_border - crop_pad; j++)
+            if (vice_raster.content[i])
             {
-               unsigned pixel = row + j * (pix_bytes >> 1);
-
-               if (abs(retro_bmp[pixel] - retro_bmp[color]) > color_diff)
-                  found++;
-
-               if (     found
-                     && retro_bmp[lb_color] != retro_bmp[pixel]
-                     && retro_bmp[rb_color] != retro_bmp[pixel])
-               {
-#if 0
-                  printf("%s: FRST %3d %3d, %3d %d %d\n", __func__, i, j, found, retro_bmp[color], retro_bmp[pixel]);
-#endif
-                  vice_raster.first_line = i;
-                  break;
-               }
-            }
-
-            if (vice_raster.first_line < crop_top_border)
+               vice_raster.first_line = i;
                break;
+            }
          }
 
 #if defined(__X64__) || defined(__X64SC__) || defined(__X64DTV__) || defined(__X128__) || defined(__XSCPU64__) || defined(__XCBM5x0__)
@@ -228,36 +223,16 @@ static void video_canvas_crop(struct video_canvas_s *canvas)
          /* Bottom border, start from bottom, almost */
          for (i = retroh - 2; i > crop_bottom_border && !vice_raster.blanked; i--)
          {
-            unsigned row      = i * (retrow << (pix_bytes >> 2));
-            unsigned color    = row + (crop_left_border + crop_pad) * (pix_bytes >> 1);
-            unsigned lb_color = row + crop_pad * (pix_bytes >> 1);
-            unsigned rb_color = row + (retrow - crop_left_border) * (pix_bytes >> 1);
-            unsigned found    = 0;
-
-            for (j = crop_left_border + crop_pad; j < retrow - crop_left_border - crop_pad; j++)
-            {
-               unsigned pixel = row + j * (pix_bytes >> 1);
-
-               if (abs(retro_bmp[pixel] - retro_bmp[color]) > color_diff)
-                  found++;
-
-               if (     found
-                     && retro_bmp[lb_color] != retro_bmp[pixel]
-                     && retro_bmp[rb_color] != retro_bmp[pixel]
-                  )
-               {
-#if 0
-                  printf("%s: LAST %3d %3d, %3d %d %d\n", __func__, i, j, found, retro_bmp[color], retro_bmp[pixel]);
-#endif
-                  vice_raster.last_line = i + 1;
-                  break;
-               }
-            }
+            if (vice_raster.content[i])
+               vice_raster.last_line = i + 1;
 
             if (vice_raster.last_line > crop_top_border + crop_height_max)
                break;
          }
 
+         /* Rows the next frame does not draw must not count from this one */
+         memset(vice_raster.content, 0, sizeof(vice_raster.content));
+
 #if defined(__X128__)
          if (c128_vdc)
          {
@@ -380,6 +355,268 @@ static void video_canvas_crop(struct video_canvas_s *canvas)
    vice_raster.blanked         = 0;
 }
 
+/* Frame pipelining
+ *
+ * At the end of an emulated frame the draw buffer is only captured, together
+ * with everything the renderers look at, and retro_run() hands the capture
+ * to a worker thread that renders it into the retro_bmp buffer not being
+ * presented. The worker gets the whole next retro_run() to finish, so the
+ * presented frame is always the previous one.
+ *
+ * Overlays (statusbar, virtual keyboard) read UI and input state that keeps
+ * changing on the main thread, so they are still drawn there, onto the
+ * completed buffer when it is presented. */
+int video_pipeline_enabled = 0;
+
+#ifdef HAVE_THREADS
+#include "rthreads/tpool.h"
+
+/* x128 may refresh both the VIC-II and the VDC canvas in one frame */
+#define VIDEO_PIPELINE_CANVASES_MAX 2
+
+typedef struct video_pipeline_canvas_s {
+   video_render_config_t config;
+   viewport_t viewport;
+   uint8_t *src;
+   size_t src_size;
+   unsigned int pitchs;
+   unsigned int width, height, xs, ys;
+} video_pipeline_canvas_t;
+
+typedef struct video_pipeline_frame_s {
+   video_pipeline_canvas_t canvas[VIDEO_PIPELINE_CANVASES_MAX];
+   int num_canvases;
+   unsigned short int *trg;
+   unsigned int pitcht;
+   /* Auto crop result for this frame, applied once it is presented */
+   int crop_valid;
+   int crop_update;
+   unsigned crop_first_line;
+   unsigned crop_last_line;
+} video_pipeline_frame_t;
+
+static video_pipeline_frame_t video_pipeline_frames[2];
+static tpool_t *video_pipeline_pool = NULL;
+static int video_pipeline_busy = 0;   /* a frame has been handed to the worker */
+static int video_pipeline_next = 0;   /* frame and buffer the next capture goes to */
+static int video_pipeline_ready = -1; /* buffer holding the last completed frame */
+static int video_pipeline_fresh = 0;  /* ready buffer has not been presented yet */
+
+static void video_pipeline_func(void *arg)
+{
+   video_pipeline_frame_t *frame = (video_pipeline_frame_t *)arg;
+   video_pipeline_canvas_t *c;
+   int i;
+
+   for (i = 0; i < frame->num_canvases; i++)
+   {
+      c = &frame->canvas[i];
+      video_render_pixels(&c->config, c->src, (uint8_t *)frame->trg,
+            c->width, c->height, c->xs, c->ys, 0, 0,
+            c->pitchs, frame->pitcht, &c->viewport);
+   }
+}
+
+/* Wait for the frame on the worker, it becomes the one to present */
+static void video_pipeline_wait(void)
+{
+   video_pipeline_frame_t *frame;
+
+   if (!video_pipeline_busy)
+      return;
+
+   tpool_wait(video_pipeline_pool);
+   video_pipeline_busy  = 0;
+   video_pipeline_ready = video_pipeline_next ^ 1;
+   video_pipeline_fresh = 1;
+
+   /* Geometry follows the frame presented, not the one emulated */
+   frame = &video_pipeline_frames[video_pipeline_ready];
+   if (frame->crop_valid)
+   {
+      vice_raster.first_line = frame->crop_first_line;
+      vice_raster.last_line  = frame->crop_last_line;
+      if (frame->crop_update)
+         crop_id_prev = -1;
+      frame->crop_valid = 0;
+   }
+}
+
+/* Let the frame on the worker finish, before changing anything it uses */
+void video_pipeline_sync(void)
+{
+   video_pipeline_wait();
+}
+
+void video_pipeline_set(int enable)
+{
+   int i, j;
+
+   if (enable == video_pipeline_enabled)
+      return;
+
+   if (!enable)
+   {
+      if (video_pipeline_pool)
+      {
+         video_pipeline_wait();
+         tpool_destroy(video_pipeline_pool);
+         video_pipeline_pool = NULL;
+      }
+      for (i = 0; i < 2; i++)
+      {
+         for (j = 0; j < VIDEO_PIPELINE_CANVASES_MAX; j++)
+         {
+            lib_free(video_pipeline_frames[i].canvas[j].src);
+            video_pipeline_frames[i].canvas[j].src      = NULL;
+            video_pipeline_frames[i].canvas[j].src_size = 0;
+         }
+         video_pipeline_frames[i].num_canvases = 0;
+      }
+      video_pipeline_enabled = 0;
+      return;
+   }
+
+   video_pipeline_pool = tpool_create(1);
+   if (!video_pipeline_pool)
+      return;
+
+   /* Start rendering into the buffer not on screen */
+   video_pipeline_next    = (retro_bmp == retro_bmp_buffer[0]) ? 1 : 0;
+   video_pipeline_ready   = -1;
+   video_pipeline_fresh   = 0;
+   video_pipeline_enabled = 1;
+}
+
+/* Take a copy of what the canvas would render now */
+static void video_pipeline_capture(struct video_canvas_s *canvas)
+{
+   video_pipeline_frame_t *frame = &video_pipeline_frames[video_pipeline_next];
+   video_pipeline_canvas_t *c;
+   draw_buffer_t *draw_buffer = canvas->draw_buffer;
+   size_t size = draw_buffer->draw_buffer_width * draw_buffer->draw_buffer_height;
+
+   if (frame->num_canvases >= VIDEO_PIPELINE_CANVASES_MAX)
+      return;
+
+   /* Same palette upkeep as video_canvas_render() */
+   if (canvas->viewport->crt_type != canvas->crt_type)
+   {
+      canvas->videoconfig->color_tables.updated = 0;
+      canvas->crt_type = canvas->viewport->crt_type;
+   }
+   if (!canvas->videoconfig->color_tables.updated)
+      video_color_update_palette(canvas);
+
+   /* Audio leak must stay in step with the emulation */
+   video_sound_update(canvas->videoconfig, draw_buffer->draw_buffer,
+         retrow, retroh,
+         retroXS, retroYS,
+         draw_buffer->draw_buffer_width,
+         canvas->viewport);
+
+   c = &frame->canvas[frame->num_canvases++];
+   if (c->src_size != size)
+   {
+      c->src      = lib_realloc(c->src, size);
+      c->src_size = size;
+   }
+   memcpy(c->src, draw_buffer->draw_buffer, size);
+   memcpy(&c->config, canvas->videoconfig, sizeof(c->config));
+   memcpy(&c->viewport, canvas->viewport, sizeof(c->viewport));
+   c->pitchs = draw_buffer->draw_buffer_width;
+   c->width  = retrow;
+   c->height = retroh;
+   c->xs     = retroXS;
+   c->ys     = retroYS;
+}
+
+/* Auto crop the frame just emulated, but keep the result with the frame
+ * until it is presented */
+static void video_pipeline_crop(struct video_canvas_s *canvas)
+{
+   video_pipeline_frame_t *frame = &video_pipeline_frames[video_pipeline_next];
+   unsigned first_line           = vice_raster.first_line;
+   unsigned last_line            = vice_raster.last_line;
+   int id_prev                   = crop_id_prev;
+
+   video_canvas_crop(canvas);
+
+   frame->crop_valid      = 1;
+   frame->crop_update     = (crop_id_prev != id_prev);
+   frame->crop_first_line = vice_raster.first_line;
+   frame->crop_last_line  = vice_raster.last_line;
+
+   vice_raster.first_line = first_line;
+   vice_raster.last_line  = last_line;
+   crop_id_prev           = id_prev;
+}
+
+/* Called once the frame is emulated */
+void video_pipeline_submit(void)
+{
+   video_pipeline_frame_t *frame;
+
+   if (!video_pipeline_enabled)
+      return;
+
+   frame = &video_pipeline_frames[video_pipeline_next];
+   if (!frame->num_canvases)
+      return;
+
+   video_pipeline_wait();
+
+   frame->trg    = retro_bmp_buffer[video_pipeline_next];
+   frame->pitcht = retrow * pix_bytes;
+   if (!tpool_add_work(video_pipeline_pool, video_pipeline_func, frame))
+      video_pipeline_func(frame);
+   video_pipeline_busy = 1;
+   video_pipeline_next ^= 1;
+
+   /* The frame captured next goes to the buffer just finished, which is
+    * presented before that */
+   video_pipeline_frames[video_pipeline_next].num_canvases = 0;
+   video_pipeline_frames[video_pipeline_next].crop_valid   = 0;
+}
+
+/* Switch retro_bmp to the last completed frame */
+void video_pipeline_present(void)
+{
+   if (!video_pipeline_enabled)
+      return;
+
+   /* Only a completed frame counts as rendered into retro_bmp */
+   retro_bmp_rendered = (video_pipeline_ready >= 0);
+   if (video_pipeline_ready < 0)
+      return;
+
+   retro_bmp = retro_bmp_buffer[video_pipeline_ready];
+
+   if (video_pipeline_fresh)
+   {
+      video_pipeline_fresh = 0;
+      if (retro_vkbd)
+         print_vkbd();
+   }
+}
+#else
+void video_pipeline_sync(void)
+{
+}
+
+void video_pipeline_set(int enable)
+{
+}
+
+void video_pipeline_submit(void)
+{
+}
+
+void video_pipeline_present(void)
+{
+}
+#endif
+
 void video_canvas_refresh(struct video_canvas_s *canvas,
       unsigned int xs, unsigned int ys,
       unsigned int xi, unsigned int yi,
@@ -389,20 +626,49 @@ void video_canvas_refresh(struct video_canvas_s *canvas,
    printf("XS:%d YS:%d XI:%d YI:%d W:%d H:%d\n",xs,ys,xi,yi,w,h);
 #endif
 
+   /* Hidden frame, only keep the audio leak fed from the draw buffer */
+   if (retro_video_hidden)
+   {
+      video_sound_update(canvas->videoconfig, canvas->draw_buffer->draw_buffer,
+            retrow, retroh,
+            retroXS, retroYS,
+            canvas->draw_buffer->draw_buffer_width,
+            canvas->viewport);
+      return;
+   }
+
+   /* The geometry may have changed since the frame was started */
+   retro_fb_check();
+
+#ifdef HAVE_THREADS
+   if (video_pipeline_enabled)
+      video_pipeline_capture(canvas);
+   else
+#endif
    video_canvas_render(
-         canvas, (uint8_t *)&retro_bmp,
+         canvas, (uint8_t *)retro_bmp,
          retrow, retroh,
          retroXS, retroYS,
          0, 0, /*xi, yi,*/
          retrow * pix_bytes
    );
+   retro_bmp_rendered = true;
 
    /* Automatic crop */
    if (crop_id >= CROP_AUTO)
+   {
+#ifdef HAVE_THREADS
+      if (video_pipeline_enabled)
+         video_pipeline_crop(canvas);
+      else
+#endif
       video_canvas_crop(canvas);
+   }
+   else
+      vice_raster.crop_xe = 0;
 
-   /* Virtual keyboard */
-   if (retro_vkbd)
+   /* Virtual keyboard, pipelined frames get it when presented */
+   if (retro_vkbd && !video_pipeline_enabled)
       print_vkbd();
 }
 
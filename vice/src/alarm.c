@@ -54,6 +54,7 @@ void alarm_context_init(alarm_context_t *context, const char *name)
 
     context->num_pending_alarms = 0;
     context->next_pending_alarm_clk = CLOCK_MAX;
+    context->next_pending_alarm_idx = -1;
 }
 
 void alarm_context_destroy(alarm_context_t *context)
@@ -79,13 +80,19 @@ void alarm_context_destroy(alarm_context_t *context)
 void alarm_context_time_warp(alarm_context_t *context, CLOCK warp_amount,
                              int warp_direction)
 {
-    unsigned int i;
+    unsigned int i, num;
+    alarm_t *head;
 
     if (warp_direction == 0) {
         return;
     }
 
-    for (i = 0; i < context->num_pending_alarms; i++) {
+    num = context->num_pending_alarms;
+    if (num == 0) {
+        return;
+    }
+
+    for (i = 0; i < num; i++) {
         if (warp_direction > 0) {
             context->pending_alarms[i].clk += warp_amount;
         } else {
@@ -93,11 +100,19 @@ void alarm_context_time_warp(alarm_context_t *context, CLOCK warp_amount,
         }
     }
 
-    if (warp_direction > 0) {
-        context->next_pending_alarm_clk += warp_amount;
-    } else {
-        context->next_pending_alarm_clk -= warp_amount;
+    /* Clocks that wrapped around may be out of order now, so build the
+       heap again by adding the alarms back one at a time.  */
+    head = context->pending_alarms[0].alarm;
+    for (i = 0; i < num; i++) {
+        context->num_pending_alarms = i + 1;
+        alarm_context_sift(context, (int)i, context->pending_alarms[i]);
+    }
+
+    /* The next alarm only stays so if it still is the earliest.  */
+    if (head->pending_idx != 0) {
+        alarm_context_reorder(context, head->pending_idx);
     }
+    alarm_context_set_head(context);
 }
 
 /* ------------------------------------------------------------------------ */
@@ -111,6 +126,7 @@ static void alarm_init(alarm_t *alarm, alarm_context_t *context,
     alarm->data = data;
 
     alarm->pending_idx = -1;      /* Not pending.  */
+    alarm->pending_slot = -1;
 
     /* Add to the head of the alarm list of the alarm context.  */
     if (context->alarms == NULL) {
@@ -167,7 +183,8 @@ void alarm_destroy(alarm_t *alarm)
 void alarm_unset(alarm_t *alarm)
 {
     alarm_context_t *context;
-    int idx;
+    alarm_t *moved;
+    int idx, slot, last;
 
     idx = alarm->pending_idx;
 
@@ -175,35 +192,29 @@ void alarm_unset(alarm_t *alarm)
         return;                 /* Not pending.  */
     }
     context = alarm->context;
+    slot = alarm->pending_slot;
 
-    if (context->num_pending_alarms > 1) {
-        int last;
+    last = --context->num_pending_alarms;
 
-        last = --context->num_pending_alarms;
-
-        if (last != idx) {
-            /* Let's copy the struct by hand to make sure stupid compilers
-               don't do stupid things.  */
-            context->pending_alarms[idx].alarm
-                = context->pending_alarms[last].alarm;
-            context->pending_alarms[idx].clk
-                = context->pending_alarms[last].clk;
-
-            context->pending_alarms[idx].alarm->pending_idx = idx;
-        }
+    /* Fill the hole with the last alarm of the heap.  */
+    if (last != idx) {
+        alarm_context_sift(context, idx, context->pending_alarms[last]);
+    }
 
-        if (context->next_pending_alarm_idx == idx) {
-            alarm_context_update_next_pending(context);
-        } else if (context->next_pending_alarm_idx == last) {
-            context->next_pending_alarm_idx = idx;
+    /* The alarm in the last slot takes over the slot.  */
+    if (last != slot) {
+        moved = context->pending_slots[last];
+        context->pending_slots[slot] = moved;
+        moved->pending_slot = slot;
+        if (context->pending_alarms[moved->pending_idx].order != ALARM_ORDER_HEAD) {
+            alarm_context_reorder(context, moved->pending_idx);
         }
-    } else {
-        context->num_pending_alarms = 0;
-        context->next_pending_alarm_clk = CLOCK_MAX;
-        context->next_pending_alarm_idx = -1;
     }
 
+    alarm_context_set_head(context);
+
     alarm->pending_idx = -1;
+    alarm->pending_slot = -1;
 }
 
 void alarm_log_too_many_alarms(void)
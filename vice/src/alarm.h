@@ -49,6 +49,11 @@ struct alarm_s {
        pending.  */
     int pending_idx;
 
+    /* Slot the alarm has in the pending order: alarms are added at the end
+       and the last one fills the slot of an alarm being unset.  Alarms due
+       on the same clock are dispatched by slot, see `alarm_order()'.  */
+    int pending_slot;
+
     /* Call data */
     void *data;
 
@@ -63,6 +68,9 @@ struct pending_alarms_s {
 
     /* Clock tick at which this alarm should be activated.  */
     CLOCK clk;
+
+    /* Tie break between alarms activated at the same clock, lower first.  */
+    unsigned int order;
 };
 typedef struct pending_alarms_s pending_alarms_t;
 
@@ -79,6 +87,9 @@ struct alarm_context_s {
     pending_alarms_t pending_alarms[ALARM_CONTEXT_MAX_PENDING_ALARMS];
     unsigned int num_pending_alarms;
 
+    /* Pending alarms by `pending_slot'.  */
+    struct alarm_s *pending_slots[ALARM_CONTEXT_MAX_PENDING_ALARMS];
+
     /* Clock tick for the next pending alarm.  */
     CLOCK next_pending_alarm_clk;
 
@@ -107,25 +118,93 @@ inline static CLOCK alarm_context_next_pending_clk(alarm_context_t *context)
     return context->next_pending_alarm_clk;
 }
 
-inline static void alarm_context_update_next_pending(alarm_context_t *context)
+/* The pending alarm array is a binary min-heap on the clock, the next alarm
+   to dispatch is always the first one.
+
+   Alarms due on the same clock go in the order the pending alarms were
+   scanned in before: the next alarm stays the next one until it is set
+   again or unset, then the one in the highest slot goes first.  The head
+   of the heap gets `ALARM_ORDER_HEAD' to keep its place.  */
+#define ALARM_ORDER_HEAD 0
+
+inline static unsigned int alarm_order(const alarm_t *alarm)
 {
-    CLOCK next_pending_alarm_clk = CLOCK_MAX;
-    int next_pending_alarm_idx;
-    unsigned int i;
+    return ALARM_CONTEXT_MAX_PENDING_ALARMS - (unsigned int)alarm->pending_slot;
+}
 
-    next_pending_alarm_idx = context->next_pending_alarm_idx;
+inline static int alarm_pending_before(const pending_alarms_t *a,
+                                       const pending_alarms_t *b)
+{
+    return a->clk < b->clk || (a->clk == b->clk && a->order < b->order);
+}
 
-    for (i = 0; i < context->num_pending_alarms; i++) {
-        CLOCK pending_clk = context->pending_alarms[i].clk;
+/* Move `entry' into heap slot `idx' or wherever it belongs from there.  */
+inline static void alarm_context_sift(alarm_context_t *context, int idx,
+                                      pending_alarms_t entry)
+{
+    pending_alarms_t *heap = context->pending_alarms;
+    int num = (int)context->num_pending_alarms;
+    int parent, child;
+
+    while (idx > 0) {
+        parent = (idx - 1) >> 1;
+        if (!alarm_pending_before(&entry, &heap[parent])) {
+            break;
+        }
+        heap[idx] = heap[parent];
+        heap[idx].alarm->pending_idx = idx;
+        idx = parent;
+    }
 
-        if (pending_clk <= next_pending_alarm_clk) {
-            next_pending_alarm_clk = pending_clk;
-            next_pending_alarm_idx = (int)i;
+    for (;;) {
+        child = (idx << 1) + 1;
+        if (child >= num) {
+            break;
+        }
+        if (child + 1 < num && alarm_pending_before(&heap[child + 1], &heap[child])) {
+            child++;
         }
+        if (!alarm_pending_before(&heap[child], &entry)) {
+            break;
+        }
+        heap[idx] = heap[child];
+        heap[idx].alarm->pending_idx = idx;
+        idx = child;
+    }
+
+    heap[idx] = entry;
+    entry.alarm->pending_idx = idx;
+}
+
+/* Give the alarm at `idx' its place by slot again.  */
+inline static void alarm_context_reorder(alarm_context_t *context, int idx)
+{
+    pending_alarms_t entry = context->pending_alarms[idx];
+
+    entry.order = alarm_order(entry.alarm);
+    alarm_context_sift(context, idx, entry);
+}
+
+/* Make the first alarm of the heap the next one.  */
+inline static void alarm_context_set_head(alarm_context_t *context)
+{
+    if (context->num_pending_alarms > 0) {
+        context->pending_alarms[0].order = ALARM_ORDER_HEAD;
+        context->next_pending_alarm_clk = context->pending_alarms[0].clk;
+        context->next_pending_alarm_idx = 0;
+    } else {
+        context->next_pending_alarm_clk = CLOCK_MAX;
+        context->next_pending_alarm_idx = -1;
     }
+}
 
-    context->next_pending_alarm_clk = next_pending_alarm_clk;
-    context->next_pending_alarm_idx = next_pending_alarm_idx;
+/* Pick the next alarm from scratch.  */
+inline static void alarm_context_update_next_pending(alarm_context_t *context)
+{
+    if (context->num_pending_alarms > 0) {
+        alarm_context_reorder(context, 0);
+    }
+    alarm_context_set_head(context);
 }
 
 inline static void alarm_context_dispatch(alarm_context_t *context,
@@ -146,42 +225,40 @@ inline static void alarm_context_dispatch(alarm_context_t *context,
 inline static void alarm_set(alarm_t *alarm, CLOCK cpu_clk)
 {
     alarm_context_t *context;
+    pending_alarms_t entry;
     int idx;
 
     context = alarm->context;
     idx = alarm->pending_idx;
 
-    if (idx < 0) {
-        int new_idx;
-
-        /* Not pending yet: add.  */
-
-        new_idx = (int)(context->num_pending_alarms);
-        if (new_idx >= (int)ALARM_CONTEXT_MAX_PENDING_ALARMS) {
-            alarm_log_too_many_alarms();
-            return;
-        }
+    if (idx < 0
+        && context->num_pending_alarms >= ALARM_CONTEXT_MAX_PENDING_ALARMS) {
+        alarm_log_too_many_alarms();
+        return;
+    }
 
-        context->pending_alarms[new_idx].alarm = alarm;
-        context->pending_alarms[new_idx].clk = cpu_clk;
+    /* An alarm due before the next one takes its place.  */
+    if (idx != 0 && context->num_pending_alarms > 0
+        && cpu_clk < context->pending_alarms[0].clk) {
+        alarm_context_reorder(context, 0);
+        idx = alarm->pending_idx;
+    }
 
+    if (idx < 0) {
+        /* Not pending yet: add.  */
+        idx = (int)(context->num_pending_alarms);
+        context->pending_slots[idx] = alarm;
+        alarm->pending_slot = idx;
         context->num_pending_alarms++;
+    }
 
-        if (cpu_clk < context->next_pending_alarm_clk) {
-            context->next_pending_alarm_clk = cpu_clk;
-            context->next_pending_alarm_idx = new_idx;
-        }
-
-        alarm->pending_idx = new_idx;
-    } else {
-        /* Already pending: modify.  */
+    /* Already pending alarms are just moved to their new place.  */
+    entry.alarm = alarm;
+    entry.clk = cpu_clk;
+    entry.order = alarm_order(alarm);
+    alarm_context_sift(context, idx, entry);
 
-        context->pending_alarms[idx].clk = cpu_clk;
-        if (context->next_pending_alarm_clk > cpu_clk
-            || idx == context->next_pending_alarm_idx) {
-            alarm_context_update_next_pending(context);
-        }
-    }
+    alarm_context_set_head(context);
 }
 
 #endif
@@ -28,6 +28,7 @@
 #include "maincpu.h"
 #include "mem.h"
 
+#include "c64mem.h"
 #include "cpmcart.h"
 
 #ifdef FEATURE_CPUMEMHISTORY
@@ -138,6 +139,37 @@ static void check_and_run_alternate_cpu(void)
 
 #define CHECK_AND_RUN_ALTERNATE_CPU check_and_run_alternate_cpu();
 
+#ifndef FEATURE_CPUMEMHISTORY
+/* Data reads from RAM, the internal ROMs and plain cartridge ROM banks index
+   memory directly instead of calling through the read table, the same way
+   opcode fetches already use bank_base.  Everything else (I/O, most
+   cartridges, expansions, the CPU port) still goes through the read
+   functions.  */
+inline static uint8_t c64cpu_load(unsigned int addr)
+{
+    uint8_t *p = _mem_read_direct_tab_ptr[addr >> 8];
+
+    if (p != NULL && addr > 1) {
+        return p[(uint16_t)addr];
+    }
+    return (*_mem_read_tab_ptr[addr >> 8])((uint16_t)addr);
+}
+
+inline static uint8_t c64cpu_load_zero(unsigned int addr)
+{
+    uint8_t *p = _mem_read_direct_tab_ptr[0];
+
+    addr &= 0xff;
+    if (p != NULL && addr > 1) {
+        return p[addr];
+    }
+    return (*_mem_read_tab_ptr[0])((uint16_t)addr);
+}
+
+#define LOAD(addr) c64cpu_load(addr)
+#define LOAD_ZERO(addr) c64cpu_load_zero(addr)
+#endif
+
 #define HAVE_Z80_REGS
 
 #include "../maincpu.c"
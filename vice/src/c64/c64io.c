@@ -78,6 +78,71 @@ static io_source_list_t c64io_dd00_head = { NULL, NULL, NULL };
 static io_source_list_t c64io_de00_head = { NULL, NULL, NULL };
 static io_source_list_t c64io_df00_head = { NULL, NULL, NULL };
 
+/* Per-address owners of each I/O page, so that the common case of a single
+   device at an address does not have to walk the list.  The tables are
+   rebuilt from the lists on the first access after a device was registered
+   or unregistered.  */
+typedef struct io_dispatch_s {
+    unsigned int generation;
+    io_source_t *read[0x100];
+    io_source_t *store[0x100];
+} io_dispatch_t;
+
+/* marks addresses shared by more than one device, these take the slow path */
+static io_source_t io_source_shared;
+#define IO_DISPATCH_SHARED (&io_source_shared)
+
+static unsigned int io_generation = 1;
+
+static io_dispatch_t c64io_d000_dispatch;
+static io_dispatch_t c64io_d100_dispatch;
+static io_dispatch_t c64io_d200_dispatch;
+static io_dispatch_t c64io_d300_dispatch;
+static io_dispatch_t c64io_d400_dispatch;
+static io_dispatch_t c64io_d500_dispatch;
+static io_dispatch_t c64io_d600_dispatch;
+static io_dispatch_t c64io_d700_dispatch;
+static io_dispatch_t c64io_dd00_dispatch;
+static io_dispatch_t c64io_de00_dispatch;
+static io_dispatch_t c64io_df00_dispatch;
+
+static void io_dispatch_add(io_source_t **owners, io_source_t *device)
+{
+    unsigned int start = device->start_address;
+    unsigned int end = device->end_address;
+    unsigned int i;
+
+    if (end < start) {
+        return;
+    }
+    /* the list of a page only serves addresses within that page */
+    if ((end & 0xff00) != (start & 0xff00)) {
+        end = (start & 0xff00) | 0xff;
+    }
+    for (i = start & 0xff; i <= (end & 0xff); i++) {
+        owners[i] = (owners[i] == NULL) ? device : IO_DISPATCH_SHARED;
+    }
+}
+
+static void io_dispatch_update(io_source_list_t *list, io_dispatch_t *dispatch)
+{
+    io_source_list_t *current = list->next;
+
+    memset(dispatch->read, 0, sizeof(dispatch->read));
+    memset(dispatch->store, 0, sizeof(dispatch->store));
+
+    while (current) {
+        if (current->device->read != NULL) {
+            io_dispatch_add(dispatch->read, current->device);
+        }
+        if (current->device->store != NULL) {
+            io_dispatch_add(dispatch->store, current->device);
+        }
+        current = current->next;
+    }
+    dispatch->generation = io_generation;
+}
+
 static void io_source_detach(io_source_detach_t *source)
 {
     switch (source->det_id) {
@@ -292,9 +357,10 @@ static void io_source_log_collisions(uint16_t addr, int amount, io_source_list_t
     }
 }
 
-static inline uint8_t io_read(io_source_list_t *list, uint16_t addr)
+static inline uint8_t io_read(io_source_list_t *list, io_dispatch_t *dispatch, uint16_t addr)
 {
     io_source_list_t *current = list->next;
+    io_source_t *owner;
     int io_source_counter = 0;
     int io_source_valid = 0;
     uint8_t realval = 0;
@@ -304,6 +370,19 @@ static inline uint8_t io_read(io_source_list_t *list, uint16_t addr)
 
     vicii_handle_pending_alarms_external(0);
 
+    if (dispatch->generation != io_generation) {
+        io_dispatch_update(list, dispatch);
+    }
+    owner = dispatch->read[addr & 0xff];
+    if (owner == NULL) {
+        return vicii_read_phi1();
+    }
+    if (owner != IO_DISPATCH_SHARED) {
+        /* a single device can not collide, whatever its priority */
+        retval = owner->read((uint16_t)(addr & owner->address_mask));
+        return owner->io_source_valid ? retval : vicii_read_phi1();
+    }
+
     while (current) {
         if (current->device->read != NULL) {
             if ((addr >= current->device->start_address) && (addr <= current->device->end_address)) {
@@ -390,15 +469,28 @@ static inline uint8_t io_peek(io_source_list_t *list, uint16_t addr)
     return vicii_read_phi1();
 }
 
-static inline void io_store(io_source_list_t *list, uint16_t addr, uint8_t value)
+static inline void io_store(io_source_list_t *list, io_dispatch_t *dispatch, uint16_t addr, uint8_t value)
 {
     int writes = 0;
     uint16_t addy = 0xffff;
     io_source_list_t *current = list->next;
+    io_source_t *owner;
     void (*store)(uint16_t address, uint8_t data) = NULL;
 
     vicii_handle_pending_alarms_external_write();
 
+    if (dispatch->generation != io_generation) {
+        io_dispatch_update(list, dispatch);
+    }
+    owner = dispatch->store[addr & 0xff];
+    if (owner == NULL) {
+        return;
+    }
+    if (owner != IO_DISPATCH_SHARED) {
+        owner->store((uint16_t)(addr & owner->address_mask), value);
+        return;
+    }
+
     while (current) {
         if (current->device->store != NULL) {
             if (addr >= current->device->start_address && addr <= current->device->end_address) {
@@ -481,6 +573,7 @@ io_source_list_t *io_source_register(io_source_t *device)
     retval->device = device;
     retval->next = NULL;
     retval->device->order = order++;
+    io_generation++;
 
     return retval;
 }
@@ -505,6 +598,8 @@ void io_source_unregister(io_source_list_t *device)
         }
     }
 
+    io_generation++;
+
     lib_free(device);
 }
 
@@ -589,7 +684,7 @@ void cartio_set_highest_order(unsigned int nr)
 uint8_t c64io_d000_read(uint16_t addr)
 {
     DBGRW(("IO: io-d000 r %04x", addr));
-    return io_read(&c64io_d000_head, addr);
+    return io_read(&c64io_d000_head, &c64io_d000_dispatch, addr);
 }
 
 uint8_t c64io_d000_peek(uint16_t addr)
@@ -601,13 +696,13 @@ uint8_t c64io_d000_peek(uint16_t addr)
 void c64io_d000_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d000 w %04x %02x", addr, value));
-    io_store(&c64io_d000_head, addr, value);
+    io_store(&c64io_d000_head, &c64io_d000_dispatch, addr, value);
 }
 
 uint8_t c64io_d100_read(uint16_t addr)
 {
     DBGRW(("IO: io-d100 r %04x", addr));
-    return io_read(&c64io_d100_head, addr);
+    return io_read(&c64io_d100_head, &c64io_d100_dispatch, addr);
 }
 
 uint8_t c64io_d100_peek(uint16_t addr)
@@ -619,13 +714,13 @@ uint8_t c64io_d100_peek(uint16_t addr)
 void c64io_d100_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d100 w %04x %02x", addr, value));
-    io_store(&c64io_d100_head, addr, value);
+    io_store(&c64io_d100_head, &c64io_d100_dispatch, addr, value);
 }
 
 uint8_t c64io_d200_read(uint16_t addr)
 {
     DBGRW(("IO: io-d200 r %04x", addr));
-    return io_read(&c64io_d200_head, addr);
+    return io_read(&c64io_d200_head, &c64io_d200_dispatch, addr);
 }
 
 uint8_t c64io_d200_peek(uint16_t addr)
@@ -637,13 +732,13 @@ uint8_t c64io_d200_peek(uint16_t addr)
 void c64io_d200_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d200 w %04x %02x", addr, value));
-    io_store(&c64io_d200_head, addr, value);
+    io_store(&c64io_d200_head, &c64io_d200_dispatch, addr, value);
 }
 
 uint8_t c64io_d300_read(uint16_t addr)
 {
     DBGRW(("IO: io-d300 r %04x", addr));
-    return io_read(&c64io_d300_head, addr);
+    return io_read(&c64io_d300_head, &c64io_d300_dispatch, addr);
 }
 
 uint8_t c64io_d300_peek(uint16_t addr)
@@ -655,13 +750,13 @@ uint8_t c64io_d300_peek(uint16_t addr)
 void c64io_d300_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d300 w %04x %02x", addr, value));
-    io_store(&c64io_d300_head, addr, value);
+    io_store(&c64io_d300_head, &c64io_d300_dispatch, addr, value);
 }
 
 uint8_t c64io_d400_read(uint16_t addr)
 {
     DBGRW(("IO: io-d400 r %04x", addr));
-    return io_read(&c64io_d400_head, addr);
+    return io_read(&c64io_d400_head, &c64io_d400_dispatch, addr);
 }
 
 uint8_t c64io_d400_peek(uint16_t addr)
@@ -673,13 +768,13 @@ uint8_t c64io_d400_peek(uint16_t addr)
 void c64io_d400_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d400 w %04x %02x", addr, value));
-    io_store(&c64io_d400_head, addr, value);
+    io_store(&c64io_d400_head, &c64io_d400_dispatch, addr, value);
 }
 
 uint8_t c64io_d500_read(uint16_t addr)
 {
     DBGRW(("IO: io-d500 r %04x", addr));
-    return io_read(&c64io_d500_head, addr);
+    return io_read(&c64io_d500_head, &c64io_d500_dispatch, addr);
 }
 
 uint8_t c64io_d500_peek(uint16_t addr)
@@ -691,13 +786,13 @@ uint8_t c64io_d500_peek(uint16_t addr)
 void c64io_d500_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d500 w %04x %02x", addr, value));
-    io_store(&c64io_d500_head, addr, value);
+    io_store(&c64io_d500_head, &c64io_d500_dispatch, addr, value);
 }
 
 uint8_t c64io_d600_read(uint16_t addr)
 {
     DBGRW(("IO: io-d600 r %04x", addr));
-    return io_read(&c64io_d600_head, addr);
+    return io_read(&c64io_d600_head, &c64io_d600_dispatch, addr);
 }
 
 uint8_t c64io_d600_peek(uint16_t addr)
@@ -709,13 +804,13 @@ uint8_t c64io_d600_peek(uint16_t addr)
 void c64io_d600_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d600 w %04x %02x", addr, value));
-    io_store(&c64io_d600_head, addr, value);
+    io_store(&c64io_d600_head, &c64io_d600_dispatch, addr, value);
 }
 
 uint8_t c64io_d700_read(uint16_t addr)
 {
     DBGRW(("IO: io-d700 r %04x", addr));
-    return io_read(&c64io_d700_head, addr);
+    return io_read(&c64io_d700_head, &c64io_d700_dispatch, addr);
 }
 
 uint8_t c64io_d700_peek(uint16_t addr)
@@ -727,13 +822,13 @@ uint8_t c64io_d700_peek(uint16_t addr)
 void c64io_d700_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-d700 w %04x %02x", addr, value));
-    io_store(&c64io_d700_head, addr, value);
+    io_store(&c64io_d700_head, &c64io_d700_dispatch, addr, value);
 }
 
 uint8_t c64io_dd00_read(uint16_t addr)
 {
     DBGRW(("IO: io-dd00 r %04x", addr));
-    return io_read(&c64io_dd00_head, addr);
+    return io_read(&c64io_dd00_head, &c64io_dd00_dispatch, addr);
 }
 
 uint8_t c64io_dd00_peek(uint16_t addr)
@@ -745,13 +840,13 @@ uint8_t c64io_dd00_peek(uint16_t addr)
 void c64io_dd00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-dd00 w %04x %02x", addr, value));
-    io_store(&c64io_dd00_head, addr, value);
+    io_store(&c64io_dd00_head, &c64io_dd00_dispatch, addr, value);
 }
 
 uint8_t c64io_de00_read(uint16_t addr)
 {
     DBGRW(("IO: io-de00 r %04x", addr));
-    return io_read(&c64io_de00_head, addr);
+    return io_read(&c64io_de00_head, &c64io_de00_dispatch, addr);
 }
 
 uint8_t c64io_de00_peek(uint16_t addr)
@@ -763,13 +858,13 @@ uint8_t c64io_de00_peek(uint16_t addr)
 void c64io_de00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-de00 w %04x %02x", addr, value));
-    io_store(&c64io_de00_head, addr, value);
+    io_store(&c64io_de00_head, &c64io_de00_dispatch, addr, value);
 }
 
 uint8_t c64io_df00_read(uint16_t addr)
 {
     DBGRW(("IO: io-df00 r %04x", addr));
-    return io_read(&c64io_df00_head, addr);
+    return io_read(&c64io_df00_head, &c64io_df00_dispatch, addr);
 }
 
 uint8_t c64io_df00_peek(uint16_t addr)
@@ -781,7 +876,7 @@ uint8_t c64io_df00_peek(uint16_t addr)
 void c64io_df00_store(uint16_t addr, uint8_t value)
 {
     DBGRW(("IO: io-df00 w %04x %02x", addr, value));
-    io_store(&c64io_df00_head, addr, value);
+    io_store(&c64io_df00_head, &c64io_df00_dispatch, addr, value);
 }
 
 /* ---------------------------------------------------------------------------------------------------------- */
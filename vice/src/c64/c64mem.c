@@ -103,14 +103,32 @@ store_func_ptr_t *_mem_write_tab_ptr_dummy;
 static uint8_t **_mem_read_base_tab_ptr;
 static uint32_t *mem_read_limit_tab_ptr;
 
+/* Pages that data reads may take straight from memory, see LOAD() in
+   c64cpu.c.  NULL entries go through the read functions.  */
+static uint8_t *mem_read_direct_tab[NUM_CONFIGS][0x101];
+static uint8_t *mem_read_direct_tab_none[0x101];
+uint8_t **_mem_read_direct_tab_ptr = mem_read_direct_tab_none;
+
+/* Configurations with cartridge ROM pages, these get the current bank
+   pointers patched into a copy of their row.  One bit per 8k block.  */
+static int mem_read_direct_has_cart[NUM_CONFIGS];
+static uint8_t *mem_read_direct_tab_cart[0x101];
+
+/* What `mem_read_direct_tab_cart' was last built from, -1 if nothing.  */
+static int mem_read_direct_cart_config = -1;
+static uint8_t *mem_read_direct_cart_base[8];
+
 /* Memory read and write tables.  */
 static store_func_ptr_t mem_write_tab[NUM_VBANKS][NUM_CONFIGS][0x101];
 static read_func_ptr_t mem_read_tab[NUM_CONFIGS][0x101];
 static uint8_t *mem_read_base_tab[NUM_CONFIGS][0x101];
 static uint32_t mem_read_limit_tab[NUM_CONFIGS][0x101];
 
+/* Tables used while watchpoints are active, only the pages that carry a
+   watchpoint go through the watch functions.  */
 static store_func_ptr_t mem_write_tab_watch[0x101];
 static read_func_ptr_t mem_read_tab_watch[0x101];
+static uint8_t *mem_read_direct_tab_watch[0x101];
 
 /* Current video bank (0, 1, 2 or 3).  */
 static int vbank;
@@ -159,10 +177,78 @@ static void store_watch(uint16_t addr, uint8_t value)
     mem_write_tab[vbank][mem_config][addr >> 8](addr, value);
 }
 
-/* called by mem_pla_config_changed(), mem_toggle_watchpoints() */
+/* Map the ROML/ROMH pages of the current configuration straight to the
+   cartridge bank, where the cartridge allows it.  */
+static void mem_update_direct_cart(void)
+{
+    read_func_ptr_t *read_tab = mem_read_tab[mem_config];
+    int blocks = mem_read_direct_has_cart[mem_config];
+    uint8_t *base[8];
+    unsigned int i, block;
+    int changed = (mem_read_direct_cart_config != mem_config);
+
+    /* one lookup per 8k block, most config changes ($01 writes) leave
+       the configuration and all the banks as they were */
+    for (block = 4; block < 8; block++) {
+        base[block] = (blocks & (1 << block)) ? cartridge_read_base(block << 13) : NULL;
+        if (base[block] != mem_read_direct_cart_base[block]) {
+            changed = 1;
+        }
+    }
+
+    if (changed) {
+        memcpy(mem_read_direct_tab_cart, mem_read_direct_tab[mem_config], sizeof(mem_read_direct_tab_cart));
+        for (i = 0x80; i <= 0xff; i++) {
+            if (read_tab[i] == roml_read || read_tab[i] == romh_read) {
+                mem_read_direct_tab_cart[i] = base[i >> 5];
+            }
+        }
+        for (block = 4; block < 8; block++) {
+            mem_read_direct_cart_base[block] = base[block];
+        }
+        mem_read_direct_cart_config = mem_config;
+    }
+    _mem_read_direct_tab_ptr = mem_read_direct_tab_cart;
+}
+
+/* Fill the watch tables for the current configuration, from the normal
+   tables for pages the monitor does not watch.  */
+static void mem_update_tab_watch(void)
+{
+    uint8_t **direct_tab = _mem_read_direct_tab_ptr;
+    unsigned int i;
+    int ops;
+
+    for (i = 0; i <= 0x100; i++) {
+        ops = monitor_watch_page(e_comp_space, i & 0xff);
+        if (ops & MONITOR_WATCH_LOAD) {
+            mem_read_tab_watch[i] = (i == 0) ? zero_read_watch : read_watch;
+            mem_read_direct_tab_watch[i] = NULL;
+        } else {
+            mem_read_tab_watch[i] = mem_read_tab[mem_config][i];
+            mem_read_direct_tab_watch[i] = direct_tab[i];
+        }
+        if (ops & MONITOR_WATCH_STORE) {
+            mem_write_tab_watch[i] = (i == 0) ? zero_store_watch : store_watch;
+        } else {
+            mem_write_tab_watch[i] = mem_write_tab[vbank][mem_config][i];
+        }
+    }
+    _mem_read_direct_tab_ptr = mem_read_direct_tab_watch;
+}
+
+/* called by mem_pla_config_changed(), mem_toggle_watchpoints(),
+   mem_set_vbank() */
 static void mem_update_tab_ptrs(int flag)
 {
+    if (mem_read_direct_has_cart[mem_config]) {
+        mem_update_direct_cart();
+    } else {
+        _mem_read_direct_tab_ptr = mem_read_direct_tab[mem_config];
+    }
+
     if (flag) {
+        mem_update_tab_watch();
         _mem_read_tab_ptr = mem_read_tab_watch;
         _mem_write_tab_ptr = mem_write_tab_watch;
         if (flag > 1) {
@@ -207,8 +293,29 @@ void mem_toggle_watchpoints(int flag, void *context)
     see testprogs/CPU/cpuport for details and tests
 */
 
+/* RAM behind the page of `addr' for REU DMA, as long as reads and writes of
+   the page go nowhere else. Stores to the video bank only differ from plain
+   RAM stores once the VICII has pending alarms, which the REU never crosses
+   when using this. Page zero is left to zero_read_dma/zero_store_dma. */
+static uint8_t *mem_dma_ram_base(uint16_t addr)
+{
+    unsigned int page = addr >> 8;
+
+    if (page == 0 || c64_256k_enabled || plus256k_enabled || plus60k_enabled) {
+        return NULL;
+    }
+    if (_mem_read_tab_ptr[page] != ram_read
+        || (_mem_write_tab_ptr[page] != ram_store
+            && _mem_write_tab_ptr[page] != vicii_mem_vbank_store)) {
+        return NULL;
+    }
+    return mem_ram;
+}
+
 void c64_mem_init(void)
 {
+    /* Let the REU move whole spans while the VICII has nothing to do */
+    reu_direct_register(mem_dma_ram_base, vicii_pending_alarms_clk);
 }
 
 void mem_pla_config_changed(void)
@@ -816,6 +923,43 @@ void mem_read_limit_set(unsigned int base, unsigned int index, uint32_t limit)
     mem_read_limit_tab[base][index] = limit;
 }
 
+/* Derive the direct read table from the read functions, so anything an
+   expansion or cartridge hooked up keeps going through its function.  The
+   CPU port at $00/$01 is excluded by the caller, $100xx is never direct.  */
+static void mem_init_direct_tab(void)
+{
+    unsigned int i, j;
+    read_func_ptr_t f;
+    uintptr_t p;
+
+    mem_read_direct_cart_config = -1;
+    for (i = 0; i < NUM_CONFIGS; i++) {
+        mem_read_direct_has_cart[i] = 0;
+        for (j = 0; j <= 0xff; j++) {
+            f = mem_read_tab[i][j];
+            p = 0;
+            if (f == roml_read || f == romh_read) {
+                mem_read_direct_has_cart[i] |= 1 << (j >> 5);
+            }
+            if (j == 0) {
+                if (f == zero_read && !c64_256k_enabled && !plus256k_enabled) {
+                    p = (uintptr_t)mem_ram;
+                }
+            } else if (f == ram_read) {
+                p = (uintptr_t)mem_ram;
+            } else if (f == c64memrom_basic64_read) {
+                p = (uintptr_t)c64memrom_basic64_rom - ((j << 8) & 0xe000);
+            } else if (f == c64memrom_kernal64_read) {
+                p = (uintptr_t)c64memrom_kernal64_rom - ((j << 8) & 0xe000);
+            } else if (f == chargen_read) {
+                p = (uintptr_t)mem_chargen_rom - ((j << 8) & 0xf000);
+            }
+            mem_read_direct_tab[i][j] = (uint8_t *)p;
+        }
+        mem_read_direct_tab[i][0x100] = NULL;
+    }
+}
+
 void mem_initialize_memory(void)
 {
     int i, j, k;
@@ -827,14 +971,6 @@ void mem_initialize_memory(void)
 
     mem_limit_init();
 
-    /* setup watchpoint tables */
-    mem_read_tab_watch[0] = zero_read_watch;
-    mem_write_tab_watch[0] = zero_store_watch;
-    for (i = 1; i <= 0x100; i++) {
-        mem_read_tab_watch[i] = read_watch;
-        mem_write_tab_watch[i] = store_watch;
-    }
-
     resources_get_int("BoardType", &board);
 
     /* first init everything to "nothing" */
@@ -966,6 +1102,9 @@ void mem_initialize_memory(void)
     if (board == BOARD_MAX) {
         mem_limit_max_init();
     }
+
+    mem_init_direct_tab();
+    mem_update_tab_ptrs(watchpoints_active);
 }
 
 void mem_mmu_translate(unsigned int addr, uint8_t **base, int *start, int *limit)
@@ -1000,8 +1139,10 @@ void mem_set_vbank(int new_vbank)
 {
     vbank = new_vbank;
 
-    /* Do not override watchpoints on vbank switches.  */
-    if (_mem_write_tab_ptr != mem_write_tab_watch) {
+    /* The watch tables copy the write functions of the video bank.  */
+    if (watchpoints_active) {
+        mem_update_tab_ptrs(watchpoints_active);
+    } else {
         _mem_write_tab_ptr = mem_write_tab[new_vbank][mem_config];
     }
 
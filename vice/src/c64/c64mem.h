@@ -62,6 +62,9 @@ void mem_set_tape_motor_in(int val);
 
 extern uint8_t mem_chargen_rom[C64_CHARGEN_ROM_SIZE];
 
+/* Direct read pointers for the current configuration (x64 only).  */
+extern uint8_t **_mem_read_direct_tab_ptr;
+
 void mem_set_write_hook(int config, int page, store_func_t *f);
 void mem_read_tab_set(unsigned int base, unsigned int index, read_func_ptr_t read_func);
 void mem_read_base_set(unsigned int base, unsigned int index, uint8_t *mem_ptr);
@@ -112,6 +112,8 @@ static read_func_ptr_t mem_read_tab[NUM_CONFIGS][0x101];
 static uint8_t *mem_read_base_tab[NUM_CONFIGS][0x101];
 static uint32_t mem_read_limit_tab[NUM_CONFIGS][0x101];
 
+/* Tables used while watchpoints are active, only the pages that carry a
+   watchpoint go through the watch functions.  */
 static store_func_ptr_t mem_write_tab_watch[0x101];
 static read_func_ptr_t mem_read_tab_watch[0x101];
 
@@ -162,10 +164,33 @@ static void store_watch(uint16_t addr, uint8_t value)
     mem_write_tab[mem_config][addr >> 8](addr, value);
 }
 
+/* Fill the watch tables for the current configuration, from the normal
+   tables for pages the monitor does not watch.  */
+static void mem_update_tab_watch(void)
+{
+    unsigned int i;
+    int ops;
+
+    for (i = 0; i <= 0x100; i++) {
+        ops = monitor_watch_page(e_comp_space, i & 0xff);
+        if (ops & MONITOR_WATCH_LOAD) {
+            mem_read_tab_watch[i] = (i == 0) ? zero_read_watch : read_watch;
+        } else {
+            mem_read_tab_watch[i] = mem_read_tab[mem_config][i];
+        }
+        if (ops & MONITOR_WATCH_STORE) {
+            mem_write_tab_watch[i] = (i == 0) ? zero_store_watch : store_watch;
+        } else {
+            mem_write_tab_watch[i] = mem_write_tab[mem_config][i];
+        }
+    }
+}
+
 /* called by mem_pla_config_changed(), mem_toggle_watchpoints() */
 static void mem_update_tab_ptrs(int flag)
 {
     if (flag) {
+        mem_update_tab_watch();
         _mem_read_tab_ptr = mem_read_tab_watch;
         _mem_write_tab_ptr = mem_write_tab_watch;
         if (flag > 1) {
@@ -782,14 +807,6 @@ void mem_initialize_memory(void)
 
     mem_limit_init();
 
-    /* setup watchpoint tables */
-    mem_read_tab_watch[0] = zero_read_watch;
-    mem_write_tab_watch[0] = zero_store_watch;
-    for (i = 1; i <= 0x100; i++) {
-        mem_read_tab_watch[i] = read_watch;
-        mem_write_tab_watch[i] = store_watch;
-    }
-
     resources_get_int("BoardType", &board);
 
     /* first init everything to "nothing" */
@@ -1176,6 +1176,57 @@ uint8_t ultimax_romh_read_hirom(uint16_t addr)
     return ultimax_romh_read_hirom_slot1(addr);
 }
 
+/* Bank pointer for plain data reads from ROML/ROMH, used by the x64 CPU to
+   skip roml_read()/romh_read() (see mem_pla_config_changed).
+
+   Unlike cartridge_mmu_translate() the result is kept until the next memory
+   configuration change, so only carts whose ROM reads have no side effects,
+   and which signal every bank switch through mem_pla_config_changed(), may
+   return a pointer here. NULL means reads go through the hooks.
+*/
+uint8_t *cartridge_read_base(unsigned int addr)
+{
+    uint8_t *base = NULL;
+    int start, limit;
+
+    /* "Slot 0" and "Slot 1" */
+    if (mmc64_cart_enabled() || magicvoice_cart_enabled() || tpi_cart_enabled() ||
+        ieeeflash64_cart_enabled() || ramlink_cart_enabled() ||
+        isepic_cart_active() || expert_cart_enabled() || ramcart_cart_enabled() ||
+        dqbb_cart_enabled()) {
+        return NULL;
+    }
+
+    /* "Main Slot", plain ROM carts using the generic reads. Flash carts
+       (EasyFlash, GMod2) are left out as their reads also latch the value
+       for the RMW dummy write, Dinamic and Ross switch banks on I/O reads
+       without a config change. */
+    switch (mem_cartridge_type) {
+        case CARTRIDGE_COMAL80:
+        case CARTRIDGE_FUNPLAY:
+        case CARTRIDGE_GENERIC_8KB:
+        case CARTRIDGE_GENERIC_16KB:
+        case CARTRIDGE_GS:
+        case CARTRIDGE_MAGIC_DESK:
+        case CARTRIDGE_SIMONS_BASIC:
+        case CARTRIDGE_SUPER_GAMES:
+        case CARTRIDGE_ULTIMAX:
+            generic_mmu_translate(addr, &base, &start, &limit);
+            break;
+        case CARTRIDGE_OCEAN:
+            /* ROMH mirrors the ROML bank, see ocean_romh_read() */
+            if ((addr & 0xe000) == 0xa000) {
+                base = &roml_banks[roml_bank << 13] - 0xa000;
+            } else {
+                generic_mmu_translate(addr, &base, &start, &limit);
+            }
+            break;
+        default:
+            break;
+    }
+    return base;
+}
+
 /* ROMH store - mapped to E000 in ultimax mode
    - carts that use "external kernal" mode must wrap to ram_store here
 */
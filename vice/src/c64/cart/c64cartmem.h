@@ -44,6 +44,9 @@ void raml_no_ultimax_store(uint16_t addr, uint8_t value);
 void romh_no_ultimax_store(uint16_t addr, uint8_t value);
 void ramh_no_ultimax_store(uint16_t addr, uint8_t value);
 
+/* bank pointer for direct data reads, NULL if reads must use the hooks */
+uint8_t *cartridge_read_base(unsigned int addr);
+
 uint8_t ultimax_0800_0fff_read(uint16_t addr);
 void ultimax_0800_0fff_store(uint16_t addr, uint8_t value);
 uint8_t ultimax_1000_7fff_read(uint16_t addr);
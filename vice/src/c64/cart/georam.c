@@ -34,6 +34,7 @@
 #include "cartio.h"
 #include "cartridge.h"
 #include "cmdline.h"
+#include "dirtymap.h"
 #include "export.h"
 #include "lib.h"
 #include "log.h"
@@ -108,6 +109,9 @@ static uint8_t georam[2];
 static uint8_t *georam_ram = NULL;
 static int old_georam_ram_size = 0;
 
+/* Pages of the image stored to since the last incremental snapshot.  */
+static dirty_map_t georam_dirty;
+
 static log_t georam_log = LOG_DEFAULT;
 
 static int georam_activate(void);
@@ -198,7 +202,10 @@ static uint8_t georam_io1_read(uint16_t addr)
 
 static void georam_io1_store(uint16_t addr, uint8_t byte)
 {
-    georam_ram[(georam[1] * 16384) + (georam[0] * 256) + addr] = byte;
+    unsigned int offset = (georam[1] * 16384) + (georam[0] * 256) + addr;
+
+    georam_ram[offset] = byte;
+    DIRTY_MAP_MARK(&georam_dirty, offset);
 }
 
 static uint8_t georam_io2_peek(uint16_t addr)
@@ -255,6 +262,7 @@ void georam_powerup(void)
     }
     if (georam_ram) {
         ram_init_with_pattern(georam_ram, georam_size, &ramparam);
+        dirty_map_mark_all(&georam_dirty);
     }
 }
 
@@ -265,6 +273,7 @@ static int georam_activate(void)
     }
 
     georam_ram = lib_realloc((void *)georam_ram, (size_t)georam_size);
+    dirty_map_init(&georam_dirty, (unsigned int)georam_size, DIRTY_MAP_PAGE_SHIFT);
 
     /* Clear newly allocated RAM.  */
     if (georam_size > old_georam_ram_size) {
@@ -288,6 +297,7 @@ static int georam_activate(void)
             return 0;
         }
         log_message(georam_log, "Reading GEORAM image %s.", georam_filename);
+        dirty_map_mark_all(&georam_dirty);
     }
 
     georam_reset();
@@ -312,6 +322,7 @@ static int georam_deactivate(void)
     lib_free(georam_ram);
     georam_ram = NULL;
     old_georam_ram_size = 0;
+    dirty_map_shutdown(&georam_dirty);
 
     return 0;
 }
@@ -571,6 +582,7 @@ void georam_config_setup(uint8_t *rawcart)
 {
     if (georam_size > 0) {
         memcpy(georam_ram, rawcart, georam_size);
+        dirty_map_mark_all(&georam_dirty);
     }
 }
 
@@ -657,7 +669,7 @@ int georam_write_snapshot_module(snapshot_t *s)
         || SMW_B(m, (uint8_t)georam_io_swap) < 0
         || SMW_DW(m, (georam_size >> 10)) < 0
         || SMW_BA(m, georam, sizeof(georam)) < 0
-        || SMW_BA(m, georam_ram, georam_size) < 0) {
+        || SMW_DBA(m, georam_ram, georam_size, &georam_dirty) < 0) {
         snapshot_module_close(m);
         return -1;
     }
@@ -711,6 +723,7 @@ int georam_read_snapshot_module(snapshot_t *s)
     if (SMR_BA(m, georam, sizeof(georam)) < 0 || SMR_BA(m, georam_ram, georam_size) < 0) {
         goto fail;
     }
+    dirty_map_mark_all(&georam_dirty);
 
     snapshot_module_close(m);
     georam_enabled = 1;
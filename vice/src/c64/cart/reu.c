@@ -49,6 +49,7 @@
 #include "cartio.h"
 #include "cartridge.h"
 #include "cmdline.h"
+#include "dirtymap.h"
 #include "export.h"
 #include "interrupt.h"
 #include "lib.h"
@@ -233,6 +234,9 @@ static uint8_t *reu_ram = NULL;
     buffer has to cleared when resizing the REU. */
 static unsigned int old_reu_ram_size = 0;
 
+/*! \brief pages of reu_ram stored to since the last incremental snapshot */
+static dirty_map_t reu_dirty;
+
 static log_t reu_log = LOG_DEFAULT; /*!< the log output for the REU */
 
 static int reu_activate(void);
@@ -256,6 +260,17 @@ static struct reu_ba_s reu_ba = {
     NULL, NULL, NULL, 0, 0, 0, 0
 };
 
+/*! \brief interface for moving whole spans between REU and host RAM, used for x64 */
+struct reu_direct_s {
+    reu_direct_ram_callback_t *ram_base;    /*!< function that returns the RAM behind a host page, or NULL if accesses to the page have side effects */
+    reu_direct_alarm_callback_t *alarm_clk; /*!< function that returns the first clock at which machine_handle_pending_alarms() has work to do */
+    int enabled;                            /*!< flag that indicates if the above functions have been registered */
+};
+
+static struct reu_direct_s reu_direct = {
+    NULL, NULL, 0
+};
+
 static int reu_write_image = 0;
 
 static int floating_bus_value = 0xff;
@@ -583,6 +598,7 @@ void reu_config_setup(uint8_t *rawcart)
 {
     if (reu_size > 0) {
         memcpy(reu_ram, rawcart, reu_size); /* FIXME */
+        dirty_map_mark_all(&reu_dirty);
     }
 }
 
@@ -598,6 +614,15 @@ void reu_ba_register(reu_ba_check_callback_t *ba_check,
     reu_ba.enabled = 1;
 }
 
+/*! \brief register the direct host RAM interface */
+void reu_direct_register(reu_direct_ram_callback_t *ram_base,
+                         reu_direct_alarm_callback_t *alarm_clk)
+{
+    reu_direct.ram_base = ram_base;
+    reu_direct.alarm_clk = alarm_clk;
+    reu_direct.enabled = 1;
+}
+
 /*! \brief reset the REU */
 void reu_reset(void)
 {
@@ -661,6 +686,7 @@ static void reu_init_ram(void)
                 invertblock(0x02ac00 + ((i + b) << 16), 0x2a00);
             }
         }
+        dirty_map_mark_all(&reu_dirty);
     }
 }
 
@@ -682,6 +708,7 @@ static int reu_activate(void)
     }
 
     reu_ram = lib_realloc(reu_ram, reu_size);
+    dirty_map_init(&reu_dirty, reu_size, DIRTY_MAP_PAGE_SHIFT);
 
     /* Clear newly allocated RAM.  */
     reu_init_ram();
@@ -704,6 +731,7 @@ static int reu_activate(void)
             return 0;
         }
         log_message(reu_log, "Reading REU image %s.", reu_filename);
+        dirty_map_mark_all(&reu_dirty);
     }
 
     reu_reset();
@@ -732,6 +760,7 @@ static int reu_deactivate(void)
     lib_free(reu_ram);
     reu_ram = NULL;
     old_reu_ram_size = 0;
+    dirty_map_shutdown(&reu_dirty);
 
     return 0;
 }
@@ -1117,6 +1146,7 @@ inline static void store_to_reu(unsigned int reu_addr, uint8_t value)
     if (reu_addr < rec_options.not_backedup_addresses) {
         assert(reu_addr < reu_size);
         reu_ram[reu_addr] = value;
+        DIRTY_MAP_MARK(&reu_dirty, reu_addr);
     } else {
         DEBUG_LOG(DEBUG_LEVEL_NO_DRAM, (reu_log, "--> writing to REU address %05X, but no DRAM!", reu_addr));
     }
@@ -1227,6 +1257,77 @@ static void reu_dma_update_regs(uint16_t host_addr, unsigned int reu_addr, int l
     }
 }
 
+/*! \brief find a span of bytes that can be moved in one go
+
+  A span stays inside one host page of plain RAM and inside the DRAM of the
+  REU without wrapping around, and ends before the machine has any pending
+  alarms to handle. None of the side effects of the byte by byte loops can
+  happen within it, so only the end result has to be produced.
+
+  \param host_addr
+    The host (computer) address of the next byte
+
+  \param reu_addr
+    The REU address of the next byte
+
+  \param host_step
+    The increment to use for the host address; must be either 0 or 1
+
+  \param reu_step
+    The increment to use for the REU address; must be either 0 or 1
+
+  \param len
+    The remaining transfer length
+
+  \param cycles
+    The number of cycles the operation takes per byte
+
+  \param host
+    Set to the RAM behind host_addr, indexed by the host address
+
+  \return
+    The number of bytes in the span, 0 if the next byte has to go through
+    the byte by byte loop.
+*/
+static int reu_dma_direct_span(uint16_t host_addr, unsigned int reu_addr, int host_step, int reu_step, int len, int cycles, uint8_t **host)
+{
+    CLOCK alarm_clk;
+    unsigned int local_addr = reu_addr & 0x0007ffff;
+    unsigned int dram_addr = reu_addr & (rec_options.dram_wrap_around - 1);
+    int span = len;
+
+    if (!reu_direct.enabled || reu_ba.enabled) {
+        return 0;
+    }
+
+    /* every byte handles alarms after advancing the clock */
+    alarm_clk = reu_direct.alarm_clk();
+    if (alarm_clk <= maincpu_clk + cycles) {
+        return 0;
+    }
+    if ((alarm_clk - maincpu_clk - 1) / cycles < (CLOCK)span) {
+        span = (int)((alarm_clk - maincpu_clk - 1) / cycles);
+    }
+
+    if (local_addr >= rec_options.wrap_around || dram_addr >= rec_options.not_backedup_addresses) {
+        return 0;
+    }
+    if (reu_step) {
+        if (rec_options.wrap_around - local_addr < (unsigned int)span) {
+            span = (int)(rec_options.wrap_around - local_addr);
+        }
+        if (rec_options.not_backedup_addresses - dram_addr < (unsigned int)span) {
+            span = (int)(rec_options.not_backedup_addresses - dram_addr);
+        }
+    }
+    if (host_step && 0x100 - (host_addr & 0xff) < span) {
+        span = 0x100 - (host_addr & 0xff);
+    }
+
+    *host = reu_direct.ram_base(host_addr);
+    return (*host != NULL) ? span : 0;
+}
+
 /*! \brief DMA operation writing from the host to the REU
 
   \param host_addr
@@ -1247,6 +1348,9 @@ static void reu_dma_update_regs(uint16_t host_addr, unsigned int reu_addr, int l
 static void reu_dma_host_to_reu(uint16_t host_addr, unsigned int reu_addr, int host_step, int reu_step, int len)
 {
     uint8_t value;
+    uint8_t *host;
+    unsigned int dram_addr;
+    int span;
     DEBUG_LOG(DEBUG_LEVEL_TRANSFER_HIGH_LEVEL, (reu_log, "copy ext $%05X %s<= main $%04X%s, $%04X (%d) bytes.",
                                                 reu_addr, reu_step ? "" : "(fixed) ", host_addr, host_step ? "" : " (fixed)", len, len));
 
@@ -1255,6 +1359,25 @@ static void reu_dma_host_to_reu(uint16_t host_addr, unsigned int reu_addr, int h
     assert(len >= 1);
 
     while (len) {
+        span = reu_dma_direct_span(host_addr, reu_addr, host_step, reu_step, len, 1, &host);
+        if (span > 0) {
+            dram_addr = reu_addr & (rec_options.dram_wrap_around - 1);
+            value = host[host_addr + (span - 1) * host_step];
+            if (!reu_step) {
+                reu_ram[dram_addr] = value;
+            } else if (host_step) {
+                memcpy(reu_ram + dram_addr, host + host_addr, span);
+            } else {
+                memset(reu_ram + dram_addr, value, span);
+            }
+            dirty_map_mark_range(&reu_dirty, dram_addr, reu_step ? span : 1);
+            maincpu_clk += span;
+            host_addr = (host_addr + span * host_step) & 0xffff;
+            reu_addr = increment_reu_with_wrap_around(reu_addr + (span - 1) * reu_step, reu_step);
+            len -= span;
+            continue;
+        }
+
         nonsc_reu_clk_inc_pre();
         machine_handle_pending_alarms(0);
         value = mem_dma_read(host_addr);
@@ -1292,6 +1415,9 @@ static void reu_dma_host_to_reu(uint16_t host_addr, unsigned int reu_addr, int h
 static void reu_dma_reu_to_host(uint16_t host_addr, unsigned int reu_addr, int host_step, int reu_step, int len)
 {
     uint8_t value;
+    uint8_t *host;
+    unsigned int dram_addr;
+    int span;
     DEBUG_LOG(DEBUG_LEVEL_TRANSFER_HIGH_LEVEL, (reu_log, "copy ext $%05X %s=> main $%04X%s, $%04X (%d) bytes.",
                                                 reu_addr, reu_step ? "" : "(fixed) ", host_addr, host_step ? "" : " (fixed)", len, len));
 
@@ -1300,6 +1426,24 @@ static void reu_dma_reu_to_host(uint16_t host_addr, unsigned int reu_addr, int h
     assert(len >= 1);
 
     while (len) {
+        span = reu_dma_direct_span(host_addr, reu_addr, host_step, reu_step, len, 1, &host);
+        if (span > 0) {
+            dram_addr = reu_addr & (rec_options.dram_wrap_around - 1);
+            floating_bus_value = value = reu_ram[dram_addr + (span - 1) * reu_step];
+            if (!host_step) {
+                host[host_addr] = value;
+            } else if (reu_step) {
+                memcpy(host + host_addr, reu_ram + dram_addr, span);
+            } else {
+                memset(host + host_addr, value, span);
+            }
+            maincpu_clk += span;
+            host_addr = (host_addr + span * host_step) & 0xffff;
+            reu_addr = increment_reu_with_wrap_around(reu_addr + (span - 1) * reu_step, reu_step);
+            len -= span;
+            continue;
+        }
+
         DEBUG_LOG(DEBUG_LEVEL_TRANSFER_LOW_LEVEL, (reu_log, "Transferring byte: %x from ext $%05X to main $%04X.", reu_ram[reu_addr % reu_size], reu_addr, host_addr));
         nonsc_reu_clk_inc_pre();
         /* after a transfer from REU to host, the last (pre)fetched value from valid
@@ -1346,6 +1490,9 @@ static void reu_dma_swap(uint16_t host_addr, unsigned int reu_addr, int host_ste
 {
     uint8_t value_from_reu;
     uint8_t value_from_c64;
+    uint8_t *host;
+    unsigned int dram_addr;
+    int span, i;
     DEBUG_LOG(DEBUG_LEVEL_TRANSFER_HIGH_LEVEL, (reu_log, "swap ext $%05X %s<=> main $%04X%s, $%04X (%d) bytes.",
                                                 reu_addr, reu_step ? "" : "(fixed) ", host_addr, host_step ? "" : " (fixed)", len, len));
 
@@ -1354,6 +1501,22 @@ static void reu_dma_swap(uint16_t host_addr, unsigned int reu_addr, int host_ste
     assert(len >= 1);
 
     while (len) {
+        span = reu_dma_direct_span(host_addr, reu_addr, host_step, reu_step, len, 2, &host);
+        if (span > 0) {
+            dram_addr = reu_addr & (rec_options.dram_wrap_around - 1);
+            for (i = 0; i < span; i++) {
+                value_from_reu = reu_ram[dram_addr + i * reu_step];
+                reu_ram[dram_addr + i * reu_step] = host[host_addr + i * host_step];
+                host[host_addr + i * host_step] = value_from_reu;
+            }
+            dirty_map_mark_range(&reu_dirty, dram_addr, reu_step ? span : 1);
+            maincpu_clk += 2 * span;
+            host_addr = (host_addr + span * host_step) & 0xffff;
+            reu_addr = increment_reu_with_wrap_around(reu_addr + (span - 1) * reu_step, reu_step);
+            len -= span;
+            continue;
+        }
+
         value_from_reu = read_from_reu(reu_addr);
         nonsc_reu_clk_inc_pre();
         machine_handle_pending_alarms(0);
@@ -1398,6 +1561,9 @@ static void reu_dma_compare(uint16_t host_addr, unsigned int reu_addr, int host_
 {
     uint8_t value_from_reu;
     uint8_t value_from_c64;
+    uint8_t *host;
+    unsigned int dram_addr;
+    int span, i;
 
     uint8_t new_status_or_mask = 0;
 
@@ -1414,6 +1580,29 @@ static void reu_dma_compare(uint16_t host_addr, unsigned int reu_addr, int host_
     /* rec.status &= ~ (REU_REG_R_STATUS_VERIFY_ERROR | REU_REG_R_STATUS_END_OF_BLOCK); */
 
     while (len) {
+        /* only the bytes before the first difference are compared in one go,
+           the failing one goes through the loop below */
+        span = reu_dma_direct_span(host_addr, reu_addr, host_step, reu_step, len, 1, &host);
+        if (span > 0) {
+            dram_addr = reu_addr & (rec_options.dram_wrap_around - 1);
+            if (host_step && reu_step && !memcmp(reu_ram + dram_addr, host + host_addr, span)) {
+                i = span;
+            } else {
+                for (i = 0; i < span; i++) {
+                    if (reu_ram[dram_addr + i * reu_step] != host[host_addr + i * host_step]) {
+                        break;
+                    }
+                }
+            }
+            if (i > 0) {
+                maincpu_clk += i;
+                host_addr = (host_addr + i * host_step) & 0xffff;
+                reu_addr = increment_reu_with_wrap_around(reu_addr + (i - 1) * reu_step, reu_step);
+                len -= i;
+                continue;
+            }
+        }
+
         nonsc_reu_clk_inc_pre();
         machine_handle_pending_alarms(0);
         value_from_reu = read_from_reu(reu_addr);
@@ -1614,7 +1803,7 @@ int reu_write_snapshot_module(snapshot_t *s)
     if (0
         || SMW_DW(m, (reu_size >> 10)) < 0
         || SMW_BA(m, reu, sizeof(reu)) < 0
-        || SMW_BA(m, reu_ram, reu_size) < 0) {
+        || SMW_DBA(m, reu_ram, reu_size, &reu_dirty) < 0) {
         snapshot_module_close(m);
         return -1;
     }
@@ -1670,6 +1859,7 @@ int reu_read_snapshot_module(snapshot_t *s)
     if (SMR_BA(m, reu, sizeof(reu)) < 0 || SMR_BA(m, reu_ram, reu_size) < 0) {
         goto fail;
     }
+    dirty_map_mark_all(&reu_dirty);
 
     if (reu[REU_REG_R_STATUS] & 0x80) {
         interrupt_restore_irq(maincpu_int_status, reu_int_num, 1);
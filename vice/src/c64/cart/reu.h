@@ -48,6 +48,12 @@ void reu_ba_register(reu_ba_check_callback_t *ba_check,
                      reu_ba_steal_callback_t *ba_steal,
                      int *ba_var, int ba_mask);
 
+typedef uint8_t *reu_direct_ram_callback_t (uint16_t addr);
+typedef CLOCK reu_direct_alarm_callback_t (void);
+
+void reu_direct_register(reu_direct_ram_callback_t *ram_base,
+                         reu_direct_alarm_callback_t *alarm_clk);
+
 void reu_reset(void);
 int reu_dma(int immed);
 void reu_dma_start(void);
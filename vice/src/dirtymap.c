@@ -0,0 +1,88 @@
+/*
+ * dirtymap.c - Page granular dirty tracking for large memories.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <string.h>
+
+#include "dirtymap.h"
+#include "lib.h"
+#include "types.h"
+
+/* (Re)size the map for a block of `size' bytes. Everything starts out dirty
+   since nothing has been written anywhere yet. */
+void dirty_map_init(dirty_map_t *map, unsigned int size, unsigned int page_shift)
+{
+    unsigned int num_pages = (size + (1U << page_shift) - 1) >> page_shift;
+
+    if (num_pages != map->num_pages || map->pages == NULL) {
+        map->pages = lib_realloc(map->pages, num_pages ? num_pages : 1);
+        map->num_pages = num_pages;
+    }
+    map->page_shift = page_shift;
+    dirty_map_mark_all(map);
+}
+
+void dirty_map_shutdown(dirty_map_t *map)
+{
+    lib_free(map->pages);
+    map->pages = NULL;
+    map->num_pages = 0;
+    map->checkpoint_id = 0;
+}
+
+void dirty_map_mark_range(dirty_map_t *map, unsigned int addr, unsigned int len)
+{
+    unsigned int first, last;
+
+    if (map->pages == NULL || len == 0) {
+        return;
+    }
+
+    first = addr >> map->page_shift;
+    last = (addr + len - 1) >> map->page_shift;
+    if (last >= map->num_pages) {
+        last = map->num_pages - 1;
+    }
+    if (first <= last) {
+        memset(map->pages + first, 1, last - first + 1);
+    }
+}
+
+/* Used whenever the whole block changed behind the back of the store
+   functions (loading an image, reinit, reading a snapshot). Also forgets
+   the checkpoint so the next incremental write is a full one. */
+void dirty_map_mark_all(dirty_map_t *map)
+{
+    if (map->pages != NULL) {
+        memset(map->pages, 1, map->num_pages);
+    }
+    map->checkpoint_id = 0;
+}
+
+void dirty_map_clear(dirty_map_t *map)
+{
+    if (map->pages != NULL) {
+        memset(map->pages, 0, map->num_pages);
+    }
+}
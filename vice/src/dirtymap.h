@@ -0,0 +1,56 @@
+/*
+ * dirtymap.h - Page granular dirty tracking for large memories.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_DIRTYMAP_H
+#define VICE_DIRTYMAP_H
+
+#include "types.h"
+
+/* 256 byte pages, same granularity as the CPU sees */
+#define DIRTY_MAP_PAGE_SHIFT    8
+
+/* One flag byte per page of a memory block. Stores mark the page they hit,
+   snapshot_module_write_dirty_byte_array() clears the flags after it has
+   written the block to an incremental snapshot stream. */
+typedef struct dirty_map_s {
+    uint8_t *pages;
+    unsigned int num_pages;
+    unsigned int page_shift;
+
+    /* Incremental stream the flags are relative to, 0 if none, and where
+       the block was written in it */
+    unsigned int checkpoint_id;
+    long checkpoint_offset;
+    unsigned int checkpoint_size;
+} dirty_map_t;
+
+#define DIRTY_MAP_MARK(map, addr) ((map)->pages[(addr) >> (map)->page_shift] = 1)
+
+extern void dirty_map_init(dirty_map_t *map, unsigned int size, unsigned int page_shift);
+extern void dirty_map_shutdown(dirty_map_t *map);
+
+extern void dirty_map_mark_range(dirty_map_t *map, unsigned int addr, unsigned int len);
+extern void dirty_map_mark_all(dirty_map_t *map);
+extern void dirty_map_clear(dirty_map_t *map);
+
+#endif
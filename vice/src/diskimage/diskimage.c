@@ -721,6 +721,20 @@ int disk_image_write_half_track(disk_image_t *image, unsigned int half_track,
     }
 }
 
+/* Only needed for tracks fsimage_read_dxx_image() left pending */
+int disk_image_read_half_track(const disk_image_t *image, unsigned int half_track,
+                               struct disk_track_s *raw)
+{
+    switch (image->type) {
+        case DISK_IMAGE_TYPE_P64:
+        case DISK_IMAGE_TYPE_G64:
+        case DISK_IMAGE_TYPE_G71:
+            return -1;
+        default:
+            return fsimage_dxx_read_half_track(image, half_track, raw);
+    }
+}
+
 int disk_image_read_image(const disk_image_t *image)
 {
     switch (image->type) {
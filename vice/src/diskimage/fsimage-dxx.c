@@ -146,23 +146,146 @@ int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
     return 0;
 }
 
-int fsimage_read_dxx_image(const disk_image_t *image)
+/*-----------------------------------------------------------------------*/
+/* GCR encoding of the tracks.  */
+
+/* Offset of the first sector on a track. On real disks, the track skew
+   depends on many factors of which none is exactly defined: the mechanical
+   properties of the drive, and last not least the code used for formatting
+   the disk. Thus the offset we use here is somewhat arbitrary, the choosen
+   values are tweaked to be somewhat close to what the skew1.prg program
+   shows for the first few tracks. */
+static unsigned long fsimage_dxx_track_skew(const disk_image_t *image, unsigned int track)
 {
-    uint8_t buffer[256], *bam_id;
+    unsigned int t, track_size, sector_size;
+    unsigned long trackoffset = 0;
+
+    for (t = 1; t <= track; t++) {
+        track_size = disk_image_raw_track_size(image->type, t);
+        sector_size = SECTOR_GCR_SIZE_WITH_HEADER
+                      + disk_image_header_gap_size(image->type, t)
+                      + disk_image_gap_size(image->type, t)
+                      + (disk_image_sync_size(image->type, t) * 2);
+        /* bytes written for the previous track */
+        trackoffset += disk_image_sector_per_track(image->type, t) * sector_size
+                       - disk_image_gap_size(image->type, t);
+        trackoffset += (track_size * 100) / 270; /* time it takes to step */
+        trackoffset %= track_size;
+    }
+    return trackoffset;
+}
+
+/* Encode half track `half_track' (including the side offset) of the image.
+   `raw->size' was set up by fsimage_read_dxx_image() already. */
+int fsimage_dxx_read_half_track(const disk_image_t *image, unsigned int half_track,
+                                disk_track_t *raw)
+{
+    uint8_t buffer[256];
     int gap, headergap, synclen;
-    unsigned int track, sector, track_size;
+    unsigned int track, sector, track_size, max_sector, side;
+    unsigned long trackoffset;
     gcr_header_t header;
     fdc_err_t rf;
-    int image_has_two_single_sides = 0;
+    fsimage_t *fsimage = image->media.fsimage;
+    uint8_t *ptr, *tempgcr;
+    int sectors;
+    long offset;
+
+    track = half_track / 2;
+    track_size = (unsigned int)raw->size;
+
+    if (raw->data == NULL) {
+        raw->data = lib_malloc(track_size);
+    }
+
+    /* odd tracks, and the second side of single sided images in a 1571,
+       are empty */
+    if ((half_track & 1) || half_track - 2 >= image->max_half_tracks) {
+        memset(raw->data, 0, track_size);
+        return 0;
+    }
+
+    /* Clear track to avoid read errors.  */
+    memset(raw->data, 0x55, track_size);
+    if (track > image->tracks) {
+        return 0;
+    }
+
+    side = (fsimage->gcr_side2_track && track >= fsimage->gcr_side2_track) ? 1 : 0;
+    header.id1 = fsimage->gcr_id[side][0];
+    header.id2 = fsimage->gcr_id[side][1];
+    header.track = side ? track - fsimage->gcr_side2_track + 1 : track;
+
+    gap = disk_image_gap_size(image->type, track);
+    headergap = disk_image_header_gap_size(image->type, track);
+    synclen = disk_image_sync_size(image->type, track);
+
+    max_sector = disk_image_sector_per_track(image->type, track);
+
+    /* get temp buffer */
+    ptr = tempgcr = lib_malloc(track_size);
+    memset(ptr, 0x55, track_size);
+
+    for (sector = 0; sector < max_sector; sector++) {
+        sectors = disk_image_check_sector(image, track, sector);
+        offset = sectors * 256;
+
+#ifdef HAVE_X64_IMAGE
+        if (image->type == DISK_IMAGE_TYPE_X64) {
+            offset += X64_HEADER_LENGTH;
+        }
+#endif
+        if (sectors >= 0) {
+            rf = CBMDOS_FDC_ERR_DRIVE;
+            if (fsimage_read(fsimage, buffer, 256, offset) >= 0) {
+                if (fsimage->error_info.map != NULL) {
+                    rf = fsimage->error_info.map[sectors];
+                }
+            }
+            header.sector = sector;
+            gcr_convert_sector_to_GCR(buffer, ptr, &header, headergap, synclen, rf);
+        }
+
+        ptr += SECTOR_GCR_SIZE_WITH_HEADER + headergap + gap + (synclen * 2);
+    }
+
+    /* copy gcr data to final buffer with offset + wraparound */
+    trackoffset = fsimage_dxx_track_skew(image, track);
+    ptr = raw->data;
+    memcpy(ptr + trackoffset, tempgcr, track_size - trackoffset);
+    memcpy(ptr, tempgcr + (track_size - trackoffset), track_size - (track_size - trackoffset));
+
+    lib_free(tempgcr);
+    return 0;
+}
+
+/*-----------------------------------------------------------------------*/
+/* Intial GCR buffer setup.  */
+
+static void fsimage_dxx_pending_track(const disk_image_t *image, unsigned int half_track,
+                                      unsigned int track_size)
+{
+    disk_track_t *raw = &image->gcr->tracks[half_track];
+
+    if (raw->data != NULL) {
+        lib_free(raw->data);
+        raw->data = NULL;
+    }
+    raw->size = track_size;
+    image->gcr->state[half_track] = GCR_TRACK_PENDING;
+}
+
+/* The tracks are not encoded here, only their sizes are set up. The drive
+   encodes each of them with fsimage_dxx_read_half_track() when the head
+   gets there first. */
+int fsimage_read_dxx_image(const disk_image_t *image)
+{
+    uint8_t buffer[256], *bam_id;
+    unsigned int track, track_size;
     int double_sided_drive = 0;
     fsimage_t *fsimage = image->media.fsimage;
-    unsigned int max_sector;
-    uint8_t *ptr;
     int half_track;
     int sectors;
-    long offset;
-    unsigned long trackoffset = 0;
-    uint8_t *tempgcr;
 
     if (image->type == DISK_IMAGE_TYPE_D80
         || image->type == DISK_IMAGE_TYPE_D82) {
@@ -175,160 +298,51 @@ int fsimage_read_dxx_image(const disk_image_t *image)
 
     bam_id[0] = bam_id[1] = 0xa0;
     if (sectors >= 0) {
-        util_fpread(fsimage->fd, buffer, 256, sectors << 8);
+        fsimage_read(fsimage, buffer, 256, sectors << 8);
     } else {
         return -1;
     }
-    header.id1 = bam_id[0];
-    header.id2 = bam_id[1];
+    fsimage->gcr_id[0][0] = fsimage->gcr_id[1][0] = bam_id[0];
+    fsimage->gcr_id[0][1] = fsimage->gcr_id[1][1] = bam_id[1];
+    fsimage->gcr_side2_track = 0;
+
+    /* special case for second side of the 1571. If each side was formatted
+       separately in one-sided mode, we must start from track 1 again and use
+       the ID from the BAM on the second side. */
+    if ((image->type == DISK_IMAGE_TYPE_D71) && !(buffer[0x03] & 0x80)
+        && image->tracks >= 36) {
+        sectors = disk_image_check_sector(image, BAM_TRACK_1571 + 35, BAM_SECTOR_1571);
+
+        buffer[BAM_ID_1571] = buffer[BAM_ID_1571 + 1] = 0xa0;
+        if (sectors >= 0) {
+            fsimage_read(fsimage, buffer, 256, sectors << 8);
+        }
+        fsimage->gcr_id[1][0] = buffer[BAM_ID_1571];
+        fsimage->gcr_id[1][1] = buffer[BAM_ID_1571 + 1];
+        fsimage->gcr_side2_track = 36;
+    }
 
-    /* check double sided images */
-    image_has_two_single_sides = (image->type == DISK_IMAGE_TYPE_D71) && !(buffer[0x03] & 0x80);
     double_sided_drive = (drive_get_disk_drive_type(image->device) == DRIVE_TYPE_1571) ||
                          (drive_get_disk_drive_type(image->device) == DRIVE_TYPE_1571CR);
 
+    image->gcr->use_count = 0;
+
     /* special case for 1571: if we are inserting a d64 image into a 1571, fill
        the second side with "unformatted" data */
     if (double_sided_drive && (image->type != DISK_IMAGE_TYPE_D71)) {
-        for (header.track = track = 1; track <= image->max_half_tracks / 2; track++, header.track++) {
+        for (track = 1; track <= image->max_half_tracks / 2; track++) {
             half_track = (36 + track) * 2 - 2;
-
             track_size = disk_image_raw_track_size(image->type, track);
-            if (image->gcr->tracks[half_track].data == NULL) {
-                image->gcr->tracks[half_track].data = lib_malloc(track_size);
-            } else if (image->gcr->tracks[half_track].size != (int)track_size) {
-                image->gcr->tracks[half_track].data = lib_realloc(image->gcr->tracks[half_track].data, track_size);
-            }
-            ptr = image->gcr->tracks[half_track].data;
-            image->gcr->tracks[half_track].size = track_size;
-            /* regular track */
-            memset(ptr, 0, track_size);
-
-            /* Clear odd track */
-            half_track++;
-
-            /* create an (empty) half track */
-            if (image->gcr->tracks[half_track].data == NULL) {
-                image->gcr->tracks[half_track].data = lib_malloc(track_size);
-            } else if (image->gcr->tracks[half_track].size != (int)track_size) {
-                image->gcr->tracks[half_track].data = lib_realloc(image->gcr->tracks[half_track].data, track_size);
-            }
-            image->gcr->tracks[half_track].size = track_size;
-            ptr = image->gcr->tracks[half_track].data;
-            memset(ptr, 0, track_size);
+            fsimage_dxx_pending_track(image, half_track, track_size);
+            fsimage_dxx_pending_track(image, half_track + 1, track_size);
         }
     }
 
-    for (header.track = track = 1; track <= image->max_half_tracks / 2; track++, header.track++) {
+    for (track = 1; track <= image->max_half_tracks / 2; track++) {
         half_track = track * 2 - 2;
-
         track_size = disk_image_raw_track_size(image->type, track);
-        if (image->gcr->tracks[half_track].data == NULL) {
-            image->gcr->tracks[half_track].data = lib_malloc(track_size);
-        } else if (image->gcr->tracks[half_track].size != (int)track_size) {
-            image->gcr->tracks[half_track].data = lib_realloc(image->gcr->tracks[half_track].data, track_size);
-        }
-        ptr = image->gcr->tracks[half_track].data;
-        image->gcr->tracks[half_track].size = track_size;
-
-        if (track <= image->tracks) {
-            /* get temp buffer */
-            ptr = tempgcr = lib_malloc(track_size);
-
-            /* special case for second side of the 1571. If each side was formatted
-               separately in one-sided mode, we must start from track 1 again and use
-               the ID from the BAM on the second side. */
-            if (image_has_two_single_sides && track == 36) {
-                sectors = disk_image_check_sector(image, BAM_TRACK_1571 + 35, BAM_SECTOR_1571);
-
-                buffer[BAM_ID_1571] = buffer[BAM_ID_1571 + 1] = 0xa0;
-                if (sectors >= 0) {
-                    util_fpread(fsimage->fd, buffer, 256, sectors << 8);
-                }
-                header.id1 = buffer[BAM_ID_1571]; /* second side, update id and track */
-                header.id2 = buffer[BAM_ID_1571 + 1];
-                header.track = 1;
-            }
-
-            gap = disk_image_gap_size(image->type, track);
-            headergap = disk_image_header_gap_size(image->type, track);
-            synclen = disk_image_sync_size(image->type, track);
-
-            max_sector = disk_image_sector_per_track(image->type, track);
-
-            /* Clear track to avoid read errors.  */
-            memset(ptr, 0x55, track_size);
-
-            for (sector = 0; sector < max_sector; sector++) {
-                sectors = disk_image_check_sector(image, track, sector);
-                offset = sectors * 256;
-
-#ifdef HAVE_X64_IMAGE
-                if (image->type == DISK_IMAGE_TYPE_X64) {
-                    offset += X64_HEADER_LENGTH;
-                }
-#endif
-                if (sectors >= 0) {
-                    rf = CBMDOS_FDC_ERR_DRIVE;
-                    if (util_fpread(fsimage->fd, buffer, 256, offset) >= 0) {
-                        if (fsimage->error_info.map != NULL) {
-                            rf = fsimage->error_info.map[sectors];
-                        }
-                    }
-                    header.sector = sector;
-                    gcr_convert_sector_to_GCR(buffer, ptr, &header, headergap, synclen, rf);
-                }
-
-                ptr += SECTOR_GCR_SIZE_WITH_HEADER + headergap + gap + (synclen * 2);
-            }
-
-#if 0
-            /* copy gcr data to buffer (this creates perfectly aligned tracks) */
-            ptr = image->gcr->tracks[half_track].data;
-            memcpy(ptr, tempgcr, track_size);
-#else
-            /* copy gcr data to final buffer with offset + wraparound */
-            /* On real disks, the track skew depends on many factors of which
-               none is exactly defined: the mechanical properties of the drive,
-               and last not least the code used for formatting the disk. Thus
-               the offset we use here is somewhat arbitrary, the choosen values
-               are tweaked to be somewhat close to what the skew1.prg program
-               shows for the first few tracks. */
-            trackoffset += (ptr - tempgcr) - gap; /* bytes we have written */
-            trackoffset += (track_size * 100) / 270; /* time it takes to step */
-            trackoffset %= track_size;
-            /*printf("track: %2u sectors: %2u size: %5u offset: %5lu\n", track, max_sector, track_size, trackoffset);*/
-            ptr = image->gcr->tracks[half_track].data;
-            memset(ptr, 0x55, track_size);
-            memcpy(ptr + trackoffset, tempgcr, track_size - trackoffset);
-            memcpy(ptr, tempgcr + (track_size - trackoffset), track_size - (track_size - trackoffset));
-#endif
-            lib_free(tempgcr);
-        } else {
-            memset(ptr, 0x55, track_size);
-        }
-
-        /* Clear odd track */
-        half_track++;
-#if 0
-        /* this does not work for some reason (skew.d64 fails) */
-        if (image->gcr->tracks[half_track].data) {
-            image->gcr->tracks[half_track].size = track_size;
-            ptr = image->gcr->tracks[half_track].data;
-            memset(ptr, 0, track_size);
-        }
-#else
-        /* create an (empty) half track */
-        if (image->gcr->tracks[half_track].data == NULL) {
-            image->gcr->tracks[half_track].data = lib_malloc(track_size);
-        } else if (image->gcr->tracks[half_track].size != (int)track_size) {
-            image->gcr->tracks[half_track].data = lib_realloc(image->gcr->tracks[half_track].data, track_size);
-        }
-        image->gcr->tracks[half_track].size = track_size;
-        ptr = image->gcr->tracks[half_track].data;
-        memset(ptr, 0, track_size);
-#endif
-
+        fsimage_dxx_pending_track(image, half_track, track_size);
+        fsimage_dxx_pending_track(image, half_track + 1, track_size);
     }
     return 0;
 }
@@ -372,8 +386,10 @@ int fsimage_dxx_read_sector(const disk_image_t *image, uint8_t *buf, const disk_
     }
 
     if (harderror == 0) {
-        if (image->gcr == NULL) {
-            if (util_fpread(fsimage->fd, buf, 256, offset) < 0) {
+        /* tracks not encoded yet are read from the image directly */
+        if (image->gcr == NULL
+            || image->gcr->state[(dadr->track * 2) - 2] == GCR_TRACK_PENDING) {
+            if (fsimage_read(fsimage, buf, 256, offset) < 0) {
                 log_error(fsimage_dxx_log,
                         "Error reading T:%u S:%u from disk image.",
                         dadr->track, dadr->sector);
@@ -455,7 +471,8 @@ int fsimage_dxx_write_sector(disk_image_t *image, const uint8_t *buf, const disk
                   dadr->track, dadr->sector);
         return -1;
     }
-    if (image->gcr != NULL) {
+    if (image->gcr != NULL
+        && image->gcr->state[(dadr->track * 2) - 2] != GCR_TRACK_PENDING) {
         gcr_write_sector(&image->gcr->tracks[(dadr->track * 2) - 2], buf, (uint8_t)dadr->sector);
     }
 
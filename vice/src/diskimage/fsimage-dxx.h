@@ -36,6 +36,8 @@ struct disk_addr_s;
 void fsimage_dxx_init(void);
 
 int fsimage_read_dxx_image(const disk_image_t *image);
+int fsimage_dxx_read_half_track(const struct disk_image_s *image, unsigned int half_track,
+                                struct disk_track_s *raw);
 
 int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
                                  const struct disk_track_s *raw);
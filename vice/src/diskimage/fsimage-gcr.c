@@ -85,7 +85,7 @@ static long fsimage_gcr_seek_half_track(fsimage_t *fsimage, unsigned int half_tr
         log_error(fsimage_gcr_log, "Attempt to read without disk image.");
         return -1;
     }
-    if (util_fpread(fsimage->fd, buf, 12, 0) < 0) {
+    if (fsimage_read(fsimage, buf, 12, 0) < 0) {
         log_error(fsimage_gcr_log, "Could not read GCR disk image.");
         return -1;
     }
@@ -112,7 +112,7 @@ static long fsimage_gcr_seek_half_track(fsimage_t *fsimage, unsigned int half_tr
     }
 #endif
 
-    if (util_fpread(fsimage->fd, buf, 4, 12 + (half_track - 2) * 4) < 0) {
+    if (fsimage_read(fsimage, buf, 4, 12 + (half_track - 2) * 4) < 0) {
         log_error(fsimage_gcr_log, "Could not read GCR disk image.");
         return -1;
     }
@@ -144,7 +144,7 @@ int fsimage_gcr_read_half_track(const disk_image_t *image, unsigned int half_tra
     }
 
     if (offset != 0) {
-        if (util_fpread(fsimage->fd, buf, 2, offset) < 0) {
+        if (fsimage_read(fsimage, buf, 2, offset) < 0) {
             log_error(fsimage_gcr_log, "Could not read GCR disk image.");
             return -1;
         }
@@ -161,7 +161,7 @@ int fsimage_gcr_read_half_track(const disk_image_t *image, unsigned int half_tra
         raw->data = lib_calloc(1, track_len);
         raw->size = track_len;
 
-        if (fread(raw->data, track_len, 1, fsimage->fd) < 1) {
+        if (fsimage_read(fsimage, raw->data, track_len, offset + 2) < 0) {
             log_error(fsimage_gcr_log, "Could not read GCR disk image.");
             return -1;
         }
@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "archdep.h"
 #include "diskconstants.h"
@@ -130,6 +131,8 @@ int fsimage_open(disk_image_t *image)
 
     fsimage = image->media.fsimage;
     fsimage->error_info.map = NULL;
+    fsimage->map = NULL;
+    fsimage->map_size = 0;
 
     /* stat file to find out if it exists or if it is a directory */
     if (archdep_stat(fsimage->name, &length, &isdir) < 0) {
@@ -161,6 +164,8 @@ int fsimage_open(disk_image_t *image)
         return -1;
     }
 
+    fsimage->map = zfile_map(fsimage->fd, &fsimage->map_size);
+
     if (fsimage_probe(image) == 0) {
         return 0;
     }
@@ -192,10 +197,27 @@ int fsimage_close(disk_image_t *image)
     }
     zfile_fclose(fsimage->fd);
     fsimage->fd = NULL;
+    fsimage->map = NULL;
+    fsimage->map_size = 0;
 
     return 0;
 }
 
+/* Like util_fpread(), from the mapped image if there is one */
+int fsimage_read(const fsimage_t *fsimage, uint8_t *buf, size_t num, long offset)
+{
+    if (fsimage->map == NULL) {
+        return util_fpread(fsimage->fd, buf, num, offset);
+    }
+
+    if (offset < 0 || (size_t)offset > fsimage->map_size
+        || num > fsimage->map_size - (size_t)offset) {
+        return -1;
+    }
+    memcpy(buf, fsimage->map + offset, num);
+    return 0;
+}
+
 /*-----------------------------------------------------------------------*/
 
 int fsimage_read_sector(const disk_image_t *image, uint8_t *buf, const disk_addr_t *dadr)
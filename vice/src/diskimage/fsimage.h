@@ -42,6 +42,15 @@ typedef struct fsimage_s {
         int dirty;
         int len;
     } error_info;
+    /* Sector header IDs for tracks encoded to GCR later on. Images with two
+       separately formatted sides number the tracks of the second side from
+       1 again, `side2_track' is the first of those tracks then (0 if not). */
+    uint8_t gcr_id[2][2];
+    unsigned int gcr_side2_track;
+    /* Whole image in memory when zfile can provide it (decompressed images,
+       files opened read-only), reads are served from here then. */
+    const uint8_t *map;
+    size_t map_size;
 } fsimage_t;
 
 
@@ -60,5 +69,6 @@ int fsimage_read_sector(const struct disk_image_s *image, uint8_t *buf,
 int fsimage_write_sector(struct disk_image_s *image, const uint8_t *buf,
                          const struct disk_addr_s *dadr);
 off_t fsimage_size(const disk_image_t *image);
+int fsimage_read(const fsimage_t *fsimage, uint8_t *buf, size_t num, long offset);
 
 #endif
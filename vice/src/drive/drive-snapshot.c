@@ -860,6 +860,9 @@ static int drive_snapshot_write_gcrimage_module(snapshot_t *s, unsigned int dnr)
 #else
     num_half_tracks = MAX_TRACKS_1571 * 2;
 
+    /* all tracks are saved, including those not encoded yet */
+    drive_gcr_load_all_tracks(drive);
+
     /* Write general data */
     if (SMW_DW(m, num_half_tracks) < 0) {
         snapshot_module_close(m);
@@ -994,6 +997,7 @@ static int drive_snapshot_read_gcrimage_module(snapshot_t *s, unsigned int dnr)
                 drive->gcr->tracks[i].size = 0;
             }
         }
+        gcr_reset_track_state(drive->gcr);
     }
     snapshot_module_close(m);
 
@@ -1046,6 +1050,7 @@ static int drive_snapshot_read_gcrimage_module(snapshot_t *s, unsigned int dnr)
             drive->gcr->tracks[i].size = 0;
         }
     }
+    gcr_reset_track_state(drive->gcr);
     snapshot_module_close(m);
 
     drive->GCR_image_loaded = 1;
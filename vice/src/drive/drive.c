@@ -701,6 +701,57 @@ char *drive_jam_reason(int mynumber)
     return jam_reason[mynumber];
 }
 
+/* Make sure track `index' of the GCR image has its data, encoding it from
+   the disk image when needed. At most GCR_CACHED_TRACKS encoded tracks are
+   kept, the least recently used one is dropped again.  */
+void drive_gcr_load_track(drive_t *dptr, unsigned int index)
+{
+    gcr_t *gcr = dptr->gcr;
+    unsigned int i, cached = 0, oldest = MAX_GCR_TRACKS;
+
+    if (gcr->state[index] == GCR_TRACK_PENDING) {
+        if (dptr->image == NULL
+            || disk_image_read_half_track(dptr->image, index + 2, &gcr->tracks[index]) < 0) {
+            return;
+        }
+        gcr->state[index] = GCR_TRACK_CACHED;
+    }
+    if (gcr->state[index] != GCR_TRACK_CACHED) {
+        return;
+    }
+    gcr->last_use[index] = ++gcr->use_count;
+
+    for (i = 0; i < MAX_GCR_TRACKS; i++) {
+        if (gcr->state[i] == GCR_TRACK_CACHED) {
+            cached++;
+            if (i != index
+                && (oldest == MAX_GCR_TRACKS || gcr->last_use[i] < gcr->last_use[oldest])) {
+                oldest = i;
+            }
+        }
+    }
+    if (cached > GCR_CACHED_TRACKS && oldest != MAX_GCR_TRACKS) {
+        lib_free(gcr->tracks[oldest].data);
+        gcr->tracks[oldest].data = NULL;
+        gcr->state[oldest] = GCR_TRACK_PENDING;
+    }
+}
+
+/* Encode all pending tracks and keep them, for saving the whole GCR image */
+void drive_gcr_load_all_tracks(drive_t *dptr)
+{
+    unsigned int i;
+
+    for (i = 0; i < MAX_GCR_TRACKS; i++) {
+        if (dptr->gcr->state[i] == GCR_TRACK_PENDING) {
+            drive_gcr_load_track(dptr, i);
+        }
+        if (dptr->gcr->state[i] == GCR_TRACK_CACHED) {
+            dptr->gcr->state[i] = GCR_TRACK_LOADED;
+        }
+    }
+}
+
 /* Move the head to half track `num'.  */
 void drive_set_half_track(int num, int side, drive_t *dptr)
 {
@@ -723,6 +774,14 @@ void drive_set_half_track(int num, int side, drive_t *dptr)
         num = 2;
     }
 
+    /* FIXME: why would the offset be different for D71 and G71? */
+    tmp = (dptr->image && dptr->image->type == DISK_IMAGE_TYPE_G71) ? DRIVE_HALFTRACKS_1571 : 70;
+
+    /* a track written to but not written back must not be dropped */
+    if (dptr->GCR_dirty_track && dptr->current_half_track >= 2) {
+        dptr->gcr->state[dptr->current_half_track - 2 + (dptr->side * tmp)] = GCR_TRACK_LOADED;
+    }
+
     if (dptr->current_half_track != num || dptr->side != side) {
         dptr->current_half_track = num;
         if (dptr->p64) {
@@ -731,8 +790,7 @@ void drive_set_half_track(int num, int side, drive_t *dptr)
     }
     dptr->side = side;
 
-    /* FIXME: why would the offset be different for D71 and G71? */
-    tmp = (dptr->image && dptr->image->type == DISK_IMAGE_TYPE_G71) ? DRIVE_HALFTRACKS_1571 : 70;
+    drive_gcr_load_track(dptr, dptr->current_half_track - 2 + (dptr->side * tmp));
 
     dptr->GCR_track_start_ptr = dptr->gcr->tracks[dptr->current_half_track - 2 + (dptr->side * tmp)].data;
 
@@ -784,6 +842,9 @@ void drive_gcr_data_writeback(drive_t *drive)
         return;
     }
 
+    /* keep the written track, it may not be representable in the image */
+    drive->gcr->state[half_track - 2] = GCR_TRACK_LOADED;
+
     /* always write track to GCR images, no need to extend the image */
     if ((drive->image->type == DISK_IMAGE_TYPE_G64) ||
         (drive->image->type == DISK_IMAGE_TYPE_G71)) {
@@ -850,6 +911,7 @@ void drive_gcr_data_writeback(drive_t *drive)
         DBG(("extend track: %u drive->image->max_half_tracks: %u drive->image->tracks: %u", track, drive->image->max_half_tracks, drive->image->tracks));
         while (half_track < end_half_track) {
             DBG(("write halftrack: %u end: %u track: %u", half_track, end_half_track, half_track / 2));
+            drive_gcr_load_track(drive, half_track - 2);
             disk_image_write_half_track(drive->image, half_track, &drive->gcr->tracks[half_track - 2]);
             half_track += 2;
         }
@@ -401,6 +401,8 @@ int drive_get_disk_drive_type(int dnr);
 void drive_enable_update_ui(struct diskunit_context_s *drv);
 void drive_update_ui_status(void);
 void drive_gcr_data_writeback(struct drive_s *drive);
+void drive_gcr_load_track(struct drive_s *dptr, unsigned int index);
+void drive_gcr_load_all_tracks(struct drive_s *dptr);
 void drive_gcr_data_writeback_all(void);
 void drive_set_active_led_color(unsigned int type, unsigned int dnr);
 int drive_set_disk_drive_type(unsigned int drive_type,
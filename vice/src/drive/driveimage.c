@@ -208,6 +208,7 @@ int drive_image_attach(disk_image_t *image, unsigned int unit, unsigned int drv)
     drive->image = image;
     drive->image->gcr = drive->gcr;
     drive->image->p64 = (void*)drive->p64;
+    gcr_reset_track_state(drive->gcr);
 
     if (disk_image_read_image(drive->image) < 0) {
         drive->image = NULL;
@@ -275,6 +276,7 @@ int drive_image_detach(disk_image_t *image, unsigned int unit, unsigned int drv)
             drive->gcr->tracks[i].size = 0;
         }
     }
+    gcr_reset_track_state(drive->gcr);
     drive->detach_clk = diskunit_clk[dnr];
     drive->GCR_image_loaded = 0;
     drive->P64_image_loaded = 0;
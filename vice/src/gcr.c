@@ -65,47 +65,36 @@ static const uint8_t From_GCR_conv_data[32] =
 };
 
 
-static void gcr_convert_4bytes_to_GCR(const uint8_t *source, uint8_t *dest)
+/* Whole byte <-> 10 bit GCR conversion, done with the nybble tables above.
+   Invalid GCR quintets decode to 0, as with the nybble table. */
+static inline uint64_t gcr_conv_byte(uint8_t b)
 {
-    int i;
-    register unsigned int tdest = 0;    /* at least 16 bits for overflow shifting */
-
-    for (i = 2; i < 10; i += 2, source++, dest++)
-    {
-        tdest <<= 5;  /* make room for the upper nybble */
-        tdest |= GCR_conv_data[(*source) >> 4];
-
-        tdest <<= 5;  /* make room for the lower nybble */
-        tdest |= GCR_conv_data[(*source) & 0x0f];
-
-        *dest = (uint8_t)(tdest >> i);
-    }
-
-    *dest = (uint8_t)tdest;
+    return (uint64_t)((GCR_conv_data[b >> 4] << 5) | GCR_conv_data[b & 0x0f]);
 }
 
-static void gcr_convert_GCR_to_4bytes(const uint8_t *source, uint8_t *dest)
+static inline uint8_t from_gcr_conv_byte(unsigned int q)
 {
-    int i;
-    /* at least 24 bits for shifting into bits 16...20 */
-    register uint32_t tdest = *source;
-
-    tdest <<= 13;
-
-    for (i = 5; i < 13; i += 2, dest++)
-    {
-        source++;
-        tdest |= ((uint32_t)(*source)) << i;
-
-        /*  "tdest >> 16" could be optimized to a word
-         *  aligned access, hopefully the compiler does
-         *  this for us (in a portable way)
-         */
-        *dest = From_GCR_conv_data[(tdest >> 16) & 0x1f] << 4;
-        tdest <<= 5;
+    return (uint8_t)((From_GCR_conv_data[(q >> 5) & 0x1f] << 4) | From_GCR_conv_data[q & 0x1f]);
+}
 
-        *dest |= From_GCR_conv_data[(tdest >> 16) & 0x1f];
-        tdest <<= 5;
+/* Encode `num' groups of 4 bytes into 5 GCR bytes each. The 40 bits of a
+   group are put together in one word and stored at once. */
+static void gcr_encode_block(const uint8_t *source, uint8_t *dest, int num)
+{
+    uint64_t tdest;
+
+    while (num--) {
+        tdest = (gcr_conv_byte(source[0]) << 30)
+                | (gcr_conv_byte(source[1]) << 20)
+                | (gcr_conv_byte(source[2]) << 10)
+                | gcr_conv_byte(source[3]);
+        dest[0] = (uint8_t)(tdest >> 32);
+        dest[1] = (uint8_t)(tdest >> 24);
+        dest[2] = (uint8_t)(tdest >> 16);
+        dest[3] = (uint8_t)(tdest >> 8);
+        dest[4] = (uint8_t)tdest;
+        source += 4;
+        dest += 5;
     }
 }
 
@@ -126,13 +115,13 @@ void gcr_convert_sector_to_GCR(const uint8_t *buffer, uint8_t *data, const gcr_h
     buf[1] = chksum;
     buf[2] = header->sector;
     buf[3] = header->track;
-    gcr_convert_4bytes_to_GCR(buf, data);
+    gcr_encode_block(buf, data, 1);
     data += 5;
 
     buf[0] = header->id2;
     buf[1] = header->id1 ^ idm;
     buf[2] = buf[3] = 0x0f;
-    gcr_convert_4bytes_to_GCR(buf, data);
+    gcr_encode_block(buf, data, 1);
     data += 5;
 
     data += gap;                   /* Gap */
@@ -149,85 +138,98 @@ void gcr_convert_sector_to_GCR(const uint8_t *buffer, uint8_t *data, const gcr_h
      */
     buf[0] = (error_code == CBMDOS_FDC_ERR_NOBLOCK) ? 0x00 : 0x07;
     memcpy(buf + 1, buffer, 3);
-    chksum ^= buffer[0] ^ buffer[1] ^ buffer[2];
-    gcr_convert_4bytes_to_GCR(buf, data);
-    buffer += 3;
+    gcr_encode_block(buf, data, 1);
     data += 5;
 
-    for (i = 0; i < 63; i++) {
-        chksum ^= buffer[0] ^ buffer[1] ^ buffer[2] ^ buffer[3];
-        gcr_convert_4bytes_to_GCR(buffer, data);
-        buffer += 4;
-        data += 5;
-    }
+    /* the rest of the data block in one go */
+    gcr_encode_block(buffer + 3, data, 63);
+    data += 63 * 5;
 
-    buf[0] = buffer[0];
-    buf[1] = chksum ^ buffer[0];
+    for (i = 0; i < 256; i++) {
+        chksum ^= buffer[i];
+    }
+    buf[0] = buffer[255];
+    buf[1] = chksum;
     buf[2] = buf[3] = 0;
-    gcr_convert_4bytes_to_GCR(buf, data);
+    gcr_encode_block(buf, data, 1);
 }
 
+/* Search for the end of a sync mark (at least 10 one bits), starting at bit
+   `p' and looking at no more than `s' bits. Returns the position of the
+   first bit after the sync. Whole bytes are looked at when possible: a sync
+   can only end on the first zero bit of a byte, since a run of ones started
+   within the byte is shorter than 10 bits. */
 static int gcr_find_sync(const disk_track_t *raw, int p, int s)
 {
-    unsigned int w;
-    int b;
+    int ones, lead, end;
+    uint8_t b;
 
     if (!raw->data || !raw->size) {
         return -CBMDOS_FDC_ERR_SYNC;
     }
 
-    w = 0;
-    b = raw->data[p >> 3] << (p & 7);
-    while (s--) {
-        if (b & 0x80) {
-            w = (w << 1) | 1;
-        } else {
-            if (~w & 0x3ff) {
-                w <<= 1;
-            } else {
+    end = raw->size * 8;
+    ones = 0;
+    while (s > 0) {
+        b = raw->data[p >> 3];
+        if ((p & 7) || s < 8) {
+            /* single bit until aligned, or for the last few bits */
+            if ((b << (p & 7)) & 0x80) {
+                ones++;
+            } else if (ones >= 10) {
                 return p;
+            } else {
+                ones = 0;
             }
-        }
-        if (~p & 7) {
             p++;
-            b <<= 1;
+            s--;
+        } else if (b == 0xff) {
+            ones += 8;
+            p += 8;
+            s -= 8;
         } else {
-            p++;
-            if (p >= raw->size * 8) {
-                p = 0;
+            for (lead = 0; (b << lead) & 0x80; lead++) {
+            }
+            if (ones + lead >= 10) {
+                return p + lead;
             }
-            b = raw->data[p >> 3];
+            for (ones = 0; (b >> ones) & 1; ones++) {
+            }
+            p += 8;
+            s -= 8;
+        }
+        if (p >= end) {
+            p = 0;
         }
     }
     return -CBMDOS_FDC_ERR_SYNC;
 }
 
+/* Decode `num' groups of 5 GCR bytes starting at bit `p', wrapping around
+   at the end of the track. The bits are collected in a word and taken out
+   10 at a time. */
 static void gcr_decode_block(const disk_track_t *raw, int p, uint8_t *buf, int num)
 {
-    int shift, i, j;
-    uint8_t gcr[5], b;
-    uint8_t *offset, *end = raw->data + raw->size;
+    uint64_t acc;
+    int bits, offset, i;
 
-    shift = p & 7;
-    offset = raw->data + (p >> 3);
+    offset = p >> 3;
+    bits = 8 - (p & 7);
+    acc = raw->data[offset] & (0xff >> (p & 7));
 
-    b = offset[0] << shift;
     for (i = 0; i < num; i++, buf += 4) {
-        /* get 5 bytes of gcr data */
-        for (j = 0; j < 5; j++) {
-            offset++;
-            if (offset >= end) {
-                offset = raw->data;
-            }
-            if (shift) {
-                gcr[j] = b | ((offset[0] << shift) >> 8);
-                b = offset[0] << shift;
-            } else {
-                gcr[j] = b;
-                b = offset[0];
+        while (bits < 40) {
+            if (++offset >= raw->size) {
+                offset = 0;
             }
+            acc = (acc << 8) | raw->data[offset];
+            bits += 8;
         }
-        gcr_convert_GCR_to_4bytes(gcr, buf);
+        bits -= 40;
+        buf[0] = from_gcr_conv_byte((unsigned int)(acc >> (bits + 30)));
+        buf[1] = from_gcr_conv_byte((unsigned int)(acc >> (bits + 20)));
+        buf[2] = from_gcr_conv_byte((unsigned int)(acc >> (bits + 10)));
+        buf[3] = from_gcr_conv_byte((unsigned int)(acc >> bits));
     }
 }
 
@@ -293,10 +295,10 @@ fdc_err_t gcr_read_sector(const disk_track_t *raw, uint8_t *data, uint8_t sector
 
 fdc_err_t gcr_write_sector(disk_track_t *raw, const uint8_t *data, uint8_t sector)
 {
-    uint8_t buffer[260], *offset, *buf;
+    uint8_t buffer[260], *offset;
     uint8_t *end = raw->data + raw->size;
-    uint8_t gcr[5], chksum, b;
-    int i, j, shift, p;
+    uint8_t gcr[65 * 5], chksum, b;
+    int i, shift, p;
 
     p = gcr_find_sector_header(raw, sector);
     if (p < 0) {
@@ -322,22 +324,18 @@ fdc_err_t gcr_write_sector(disk_track_t *raw, const uint8_t *data, uint8_t secto
     buffer[257] = chksum;
     buffer[258] = buffer[259] = 0;
 
-    buf = buffer;
+    gcr_encode_block(buffer, gcr, 65);
 
-    for (i = 0; i < 65; i++) {
-        gcr_convert_4bytes_to_GCR(buf, gcr);
-        buf += 4;
-        for (j = 0; j < 5; j++) {
-            if (shift) {
-                offset[0] = b | (gcr[j] >> shift);
-                b = (gcr[j] << 8) >> shift;
-            } else {
-                offset[0] = gcr[j];
-            }
-            offset++;
-            if (offset >= end) {
-                offset = raw->data;
-            }
+    for (i = 0; i < 65 * 5; i++) {
+        if (shift) {
+            offset[0] = b | (gcr[i] >> shift);
+            b = (gcr[i] << 8) >> shift;
+        } else {
+            offset[0] = gcr[i];
+        }
+        offset++;
+        if (offset >= end) {
+            offset = raw->data;
         }
     }
     offset[0] = b | (offset[0] & (0xff >> shift));
@@ -355,3 +353,12 @@ void gcr_destroy_image(gcr_t *gcr)
     lib_free(gcr);
     return;
 }
+
+/* Mark all tracks as loaded, used whenever the track buffers are (re)filled
+   as a whole. */
+void gcr_reset_track_state(gcr_t *gcr)
+{
+    memset(gcr->state, GCR_TRACK_LOADED, sizeof(gcr->state));
+    memset(gcr->last_use, 0, sizeof(gcr->last_use));
+    gcr->use_count = 0;
+}
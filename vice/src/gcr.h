@@ -53,9 +53,23 @@ typedef struct disk_track_s {
     int size;
 } disk_track_t;
 
+/* Number of lazily encoded tracks kept around per drive */
+#define GCR_CACHED_TRACKS 8
+
+/* Track states. Sector based images are only encoded to GCR when the head
+   first gets to a track, such tracks can be dropped again as long as they
+   were not written to. */
+#define GCR_TRACK_LOADED  0     /* data is the only copy, keep it */
+#define GCR_TRACK_PENDING 1     /* not encoded yet, data is NULL */
+#define GCR_TRACK_CACHED  2     /* encoded from the image and unchanged */
+
 typedef struct gcr_s {
     /* Raw GCR image of the disk.  */
     disk_track_t tracks[MAX_GCR_TRACKS];
+    uint8_t state[MAX_GCR_TRACKS];
+    /* Last use of each cached track, for dropping the oldest one */
+    unsigned int last_use[MAX_GCR_TRACKS];
+    unsigned int use_count;
 } gcr_t;
 
 typedef struct gcr_header_s {
@@ -69,5 +83,6 @@ enum fdc_err_e gcr_write_sector(disk_track_t *raw, const uint8_t *data, uint8_t
 
 gcr_t *gcr_create_image(void);
 void gcr_destroy_image(gcr_t *gcr);
+void gcr_reset_track_state(gcr_t *gcr);
 
 #endif
@@ -191,6 +191,12 @@ void monitor_cpu_type_set_value(int searchcpu);
 void monitor_watch_push_load_addr(uint16_t addr, MEMSPACE mem);
 void monitor_watch_push_store_addr(uint16_t addr, MEMSPACE mem);
 
+/* Flags returned by monitor_watch_page() */
+#define MONITOR_WATCH_LOAD  0x01
+#define MONITOR_WATCH_STORE 0x02
+
+int monitor_watch_page(MEMSPACE mem, unsigned int page);
+
 monitor_interface_t *monitor_interface_new(void);
 void monitor_interface_destroy(monitor_interface_t *monitor_interface);
 
@@ -68,6 +68,12 @@ static checkpoint_list_t *breakpoints[NUM_MEMSPACES];
 static checkpoint_list_t *watchpoints_load[NUM_MEMSPACES];
 static checkpoint_list_t *watchpoints_store[NUM_MEMSPACES];
 
+/* MEMORY_OP bits of the checkpoints covering each of the 64K addresses of a
+   memspace (folded to the low 16 bits), and of each of its pages. The lists
+   above stay authoritative, the maps only rule out addresses quickly. */
+static uint8_t *checkpoint_map[NUM_MEMSPACES];
+static uint8_t checkpoint_page_map[NUM_MEMSPACES][0x100];
+
 
 void mon_breakpoint_init(void)
 {
@@ -156,8 +162,81 @@ mon_checkpoint_t *mon_breakpoint_find_checkpoint(int brknum)
     return NULL;
 }
 
+static void mark_checkpoint_list(MEMSPACE mem, checkpoint_list_t *ptr, MEMORY_OP op)
+{
+    unsigned int start, end, loc;
+
+    for (; ptr != NULL; ptr = ptr->next) {
+        start = addr_location(ptr->checkpt->start_addr);
+        end = start;
+        if (mon_is_valid_addr(ptr->checkpt->end_addr)) {
+            end = addr_location(ptr->checkpt->end_addr);
+        }
+
+        if (end < start || end - start >= 0xffff) {
+            /* wraps around or covers everything */
+            for (loc = 0; loc < 0x10000; loc++) {
+                checkpoint_map[mem][loc] |= op;
+            }
+            for (loc = 0; loc < 0x100; loc++) {
+                checkpoint_page_map[mem][loc] |= op;
+            }
+            continue;
+        }
+
+        for (loc = start; loc <= end; loc++) {
+            checkpoint_map[mem][loc & 0xffff] |= op;
+            checkpoint_page_map[mem][(loc >> 8) & 0xff] |= op;
+        }
+    }
+}
+
+/* Rebuild the maps of `mem' after its lists changed */
+static void update_checkpoint_map(MEMSPACE mem)
+{
+    memset(checkpoint_page_map[mem], 0, sizeof(checkpoint_page_map[mem]));
+
+    if (breakpoints[mem] == NULL
+        && watchpoints_load[mem] == NULL
+        && watchpoints_store[mem] == NULL) {
+        lib_free(checkpoint_map[mem]);
+        checkpoint_map[mem] = NULL;
+        return;
+    }
+
+    if (checkpoint_map[mem] == NULL) {
+        checkpoint_map[mem] = lib_malloc(0x10000);
+    }
+    memset(checkpoint_map[mem], 0, 0x10000);
+
+    mark_checkpoint_list(mem, breakpoints[mem], e_exec);
+    mark_checkpoint_list(mem, watchpoints_load[mem], e_load);
+    mark_checkpoint_list(mem, watchpoints_store[mem], e_store);
+}
+
+/** \brief Check whether any checkpoint of type `op' may cover `addr'
+ *
+ * \return false if there is certainly none
+ */
+bool mon_breakpoint_check_map(MEMSPACE mem, unsigned int addr, MEMORY_OP op)
+{
+    return checkpoint_map[mem] != NULL && (checkpoint_map[mem][addr & 0xffff] & op) != 0;
+}
+
+/** \brief Get the MEMORY_OP bits of the checkpoints within a page
+ *
+ * \param[in]  mem     memspace
+ * \param[in]  page    page number, the high byte of the low 16 address bits
+ */
+int mon_breakpoint_page_ops(MEMSPACE mem, unsigned int page)
+{
+    return checkpoint_page_map[mem][page & 0xff];
+}
+
 static void update_checkpoint_state(MEMSPACE mem)
 {
+    update_checkpoint_map(mem);
+
     /* calls mem_toggle_watchpoints() */
     if (watchpoints_load[mem] != NULL ||
         watchpoints_store[mem] != NULL) {
@@ -478,8 +557,13 @@ bool mon_breakpoint_check_checkpoint(MEMSPACE mem, unsigned int addr, unsigned i
     const char *op_str;
     const char *action_str;
     supported_cpu_type_list_t *cpulist;
-    int monbank = mon_interfaces[mem]->current_bank;
+    int monbank;
+
+    if (!mon_breakpoint_check_map(mem, addr, op)) {
+        return FALSE;
+    }
 
+    monbank = mon_interfaces[mem]->current_bank;
     monitor_cpu = monitor_cpu_for_memspace[mem];
     instpc = new_addr(mem, (monitor_cpu->mon_register_get_val)(mem, e_PC));
     loadstorepc = new_addr(mem, lastpc);
@@ -750,6 +834,7 @@ void mon_breakpoint_unset(MON_ADDR address)
         /* there's a breakpoint, so remove it */
         remove_checkpoint_from_list( &all_checkpoints, ptr->checkpt );
         remove_checkpoint_from_list( &breakpoints[mem], ptr->checkpt );
+        update_checkpoint_state(mem);
     }
 }
 
@@ -62,6 +62,8 @@ void mon_breakpoint_set_checkpoint_condition(int brk_num, struct cond_node_s *cn
 void mon_breakpoint_set_checkpoint_command(int brk_num, char *cmd);
 bool mon_breakpoint_check_checkpoint(MEMSPACE mem, unsigned int addr,
                                      unsigned int lastpc, MEMORY_OP op);
+bool mon_breakpoint_check_map(MEMSPACE mem, unsigned int addr, MEMORY_OP op);
+int mon_breakpoint_page_ops(MEMSPACE mem, unsigned int page);
 int mon_breakpoint_add_checkpoint(MON_ADDR start_addr, MON_ADDR end_addr,
                                   bool stop, MEMORY_OP op, bool is_temp, bool do_print);
 
@@ -56,7 +56,7 @@ static bool is_merged(profiling_context_t *context) {
 
 void mon_profile(void)
 {
-    if (maincpu_profiling) {
+    if (maincpu_profiling || profile_sampling) {
         mon_out("Profiling running.\n");
     } else if (!root_context) {
         mon_out("Profiling not started.\n");
@@ -70,7 +70,7 @@ void mon_profile_action(ACTION action)
 {
     switch(action) {
     case e_OFF: {
-        if (maincpu_profiling) {
+        if (maincpu_profiling || profile_sampling) {
             profile_stop();
             mon_out("Profiling stopped.\n");
         } else {
@@ -88,7 +88,7 @@ void mon_profile_action(ACTION action)
         return;
     }
     case e_TOGGLE: {
-        if (maincpu_profiling) {
+        if (maincpu_profiling || profile_sampling) {
             mon_profile_action(e_OFF);
         } else {
             mon_profile_action(e_ON);
@@ -104,6 +104,7 @@ static bool init_profiling_data(void) {
         return false;
     }
 
+    profile_flush_samples();
     compute_aggregate_stats(root_context);
 
     return true;
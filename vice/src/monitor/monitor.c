@@ -2856,7 +2856,8 @@ void monitor_watch_push_load_addr(uint16_t addr, MEMSPACE mem)
         return;
     }
 
-    if (watch_load_count[mem] == MONITOR_MAX_CHECKPOINTS) {
+    if (watch_load_count[mem] == MONITOR_MAX_CHECKPOINTS
+        || !mon_breakpoint_check_map(mem, addr, e_load)) {
         return;
     }
 
@@ -2871,7 +2872,8 @@ void monitor_watch_push_store_addr(uint16_t addr, MEMSPACE mem)
         return;
     }
 
-    if (watch_store_count[mem] == MONITOR_MAX_CHECKPOINTS) {
+    if (watch_store_count[mem] == MONITOR_MAX_CHECKPOINTS
+        || !mon_breakpoint_check_map(mem, addr, e_store)) {
         return;
     }
 
@@ -2880,6 +2882,14 @@ void monitor_watch_push_store_addr(uint16_t addr, MEMSPACE mem)
     watch_store_count[mem]++;
 }
 
+/* Tell which pages of `mem' have load or store watchpoints, so machines can
+   leave the others out of their watch tables. Called from the
+   toggle_watchpoints_func of the memspace. */
+int monitor_watch_page(MEMSPACE mem, unsigned int page)
+{
+    return mon_breakpoint_page_ops(mem, page) & (MONITOR_WATCH_LOAD | MONITOR_WATCH_STORE);
+}
+
 static bool watchpoints_check_loads(MEMSPACE mem, unsigned int lastpc, unsigned int pc)
 {
     bool trap = false;
@@ -31,7 +31,9 @@
 #include <stddef.h>
 #include <string.h>
 
+#include "alarm.h"
 #include "lib.h"
+#include "maincpu.h"
 #include "mem.h"
 #include "profiler.h"
 #include "profiler_data.h"
@@ -39,6 +41,10 @@
 
 #define MAX_CALLSTACK_SIZE 129
 
+/* Size of the sample ring in words. A sample takes 3 words plus 3 per
+ * call stack entry, see sample_callstack() */
+#define SAMPLE_RING_SIZE 0x10000
+
 /* Store the PC address for JSR calls and the SP where PC is stored
  * this allows us to differentiate between fake RTS/RTI-calls used as indirect
  * JMPs
@@ -58,6 +64,18 @@ bool     maincpu_profiling = false;
 bool     entered_context = false;
 bool     exited_context = false;
 
+/* In sampling mode an alarm sets maincpu_profiling every
+ * profile_sample_interval cycles, the next profile_sample_start() then
+ * copies the call stack into the ring and clears it again. The ring is
+ * folded into the context tree only when it fills up or the data is
+ * looked at. */
+bool          profile_sampling = false;
+unsigned int  profile_sample_interval = 0;
+static alarm_t  *sample_alarm = NULL;
+static bool      sample_hold = false;
+static uint16_t *sample_ring = NULL;
+static unsigned int sample_ring_pos = 0;
+
 profiling_context_t  *root_context = NULL;
 profiling_context_t  *current_context = NULL;
 uint16_t              current_pc;
@@ -214,16 +232,24 @@ static profiling_context_t *get_child_context(profiling_context_t *parent,
     return new_context;
 }
 
-/* store profiling samples */
-static void initialize_context(void) {
-    int callstack_head;
+/* find head of context (>0 if interrupt) */
+static unsigned callstack_context_head(void) {
+    unsigned callstack_head;
 
-    /* find head of context (>0 if interrupt) */
+    if (callstack_size == 0) {
+        return 0;
+    }
     for (callstack_head = callstack_size-1;
          callstack_head > 0;
          callstack_head--) {
         if (callstack_pc_src[callstack_head] >= 0xfffa) break;
     }
+    return callstack_head;
+}
+
+/* store profiling samples */
+static void initialize_context(void) {
+    unsigned callstack_head = callstack_context_head();
 
     current_context = root_context;
     while (callstack_head < callstack_size) {
@@ -237,8 +263,79 @@ static void initialize_context(void) {
     current_context = get_mem_config_context(current_context, mem_get_current_bank_config());
 }
 
+/* copy the call stack below the context head into the sample ring */
+static void sample_callstack(uint16_t pc) {
+    unsigned callstack_head = callstack_context_head();
+    unsigned depth = callstack_size - callstack_head;
+    uint16_t *p;
+
+    if (sample_ring_pos + 3 + 3 * depth > SAMPLE_RING_SIZE) {
+        profile_flush_samples();
+    }
+
+    p = sample_ring + sample_ring_pos;
+    *p++ = (uint16_t)depth;
+    *p++ = pc;
+    *p++ = (uint16_t)mem_get_current_bank_config();
+    while (callstack_head < callstack_size) {
+        *p++ = callstack_pc_dst[callstack_head];
+        *p++ = callstack_pc_src[callstack_head];
+        *p++ = callstack_memory_bank_config[callstack_head];
+        callstack_head++;
+    }
+    sample_ring_pos = (unsigned int)(p - sample_ring);
+}
+
+/* account the samples in the ring to their contexts */
+void profile_flush_samples(void)
+{
+    unsigned int pos = 0;
+    unsigned depth;
+    uint16_t pc, mem_config;
+    profiling_context_t *context;
+    profiling_data_t *data;
+
+    while (pos < sample_ring_pos) {
+        depth      = sample_ring[pos++];
+        pc         = sample_ring[pos++];
+        mem_config = sample_ring[pos++];
+
+        context = root_context;
+        while (depth--) {
+            context = get_child_context(context,
+                                        sample_ring[pos],
+                                        sample_ring[pos + 1],
+                                        sample_ring[pos + 2]);
+            pos += 3;
+        }
+        context = get_mem_config_context(context, mem_config);
+
+        data = &profiling_get_page(context, pc >> 8)->data[pc & 0xff];
+        data->num_cycles += profile_sample_interval;
+        data->num_samples++;
+    }
+    sample_ring_pos = 0;
+}
+
+/* Re-armed from the current clock rather than the due one. Alarms are only
+ * served between instructions, the few cycles of jitter this adds keep the
+ * samples from locking onto frame synchronous code. */
+static void profile_sample_alarm_handler(CLOCK offset, void *data)
+{
+    if (!sample_hold) {
+        maincpu_profiling = true;
+    }
+    alarm_set(sample_alarm, maincpu_clk + profile_sample_interval);
+}
+
 void profile_sample_start(uint16_t pc)
 {
+    if (profile_sampling) {
+        sample_callstack(pc);
+        maincpu_profiling = false;
+        return;
+    }
+
     if (exited_context) {
         current_context->num_exits++;
         exited_context = false;
@@ -258,9 +355,16 @@ void profile_sample_start(uint16_t pc)
 
 void profile_sample_finish(uint16_t cycle_time, uint16_t stolen_cycles)
 {
-    profiling_data_t * data = &profiling_get_page(current_context,
-                                                 current_pc >> 8)
-                                  ->data[current_pc & 0xff];
+    profiling_data_t * data;
+
+    if (profile_sampling) {
+        /* the alarm went off within the instruction, the sample is taken
+           at the next one */
+        return;
+    }
+
+    data = &profiling_get_page(current_context, current_pc >> 8)
+                ->data[current_pc & 0xff];
     data->num_cycles += cycle_time;
     data->num_samples++;
     current_context->total_stolen_cycles_self   += stolen_cycles;
@@ -296,11 +400,22 @@ void profile_rtx(uint8_t sp)
     exited_context = true;
 }
 
+static void profile_sampling_stop(void)
+{
+    if (profile_sampling) {
+        profile_flush_samples();
+        alarm_unset(sample_alarm);
+        profile_sampling = false;
+    }
+}
+
 void profile_start(void)
 {
+    profile_sampling_stop();
     if (root_context) free_profiling_context(root_context);
     root_context    = alloc_profiling_context();
     num_context_ids = 0;
+    profile_sample_interval = 0;
     current_context = root_context;
     maincpu_profiling = true;
     entered_context = false;
@@ -356,12 +471,57 @@ void compute_aggregate_stats(profiling_context_t *context) {
 }
 
 
+int profile_sampling_start(unsigned int interval)
+{
+    if (maincpu_alarm_context == NULL || interval == 0) {
+        return -1;
+    }
+
+    profile_start();
+    maincpu_profiling = false;
+
+    if (sample_alarm == NULL) {
+        sample_alarm = alarm_new(maincpu_alarm_context, "ProfileSample",
+                                 profile_sample_alarm_handler, NULL);
+    }
+    if (sample_ring == NULL) {
+        sample_ring = lib_malloc(SAMPLE_RING_SIZE * sizeof(*sample_ring));
+    }
+    sample_ring_pos = 0;
+    profile_sample_interval = interval;
+    profile_sampling = true;
+    alarm_set(sample_alarm, maincpu_clk + interval);
+    return 0;
+}
+
+/* The CPU clock was set back or forth by a snapshot, the alarm would
+ * otherwise stay due at a clock of the old timeline. */
+void profile_sampling_resync(void)
+{
+    if (profile_sampling) {
+        alarm_set(sample_alarm, maincpu_clk + profile_sample_interval);
+    }
+}
+
+void profile_sampling_hold(bool hold)
+{
+    sample_hold = hold;
+}
+
 void profile_stop(void)
 {
+    profile_sampling_stop();
     maincpu_profiling = false;
 }
 
 static void profile_reset(void) {
+    /* the alarm went away with the CPU alarm context */
+    sample_alarm = NULL;
+    profile_sampling = false;
+    lib_free(sample_ring);
+    sample_ring = NULL;
+    sample_ring_pos = 0;
+
     free_profiling_context(root_context);
     root_context = NULL;
     current_context = NULL;
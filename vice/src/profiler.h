@@ -30,13 +30,33 @@
 #include "types.h"
 
 extern bool maincpu_profiling;
+extern bool profile_sampling;
 
 /* resets sample statistics and starts profiling sample collection */
 void profile_start(void);
 
+/* resets sample statistics and starts sampling the call stack every
+ * `interval' cycles instead of accounting every instruction
+ * returns -1 if the CPU is not set up yet */
+int profile_sampling_start(unsigned int interval);
+
+/* re-arms the sample alarm from the current clock, for after a snapshot
+ * was loaded */
+void profile_sampling_resync(void);
+
+/* while held the sample alarm keeps running but no samples are taken,
+ * for frames that are emulated again later (run-ahead) */
+void profile_sampling_hold(bool hold);
+
 /* stops profiling and writes profiling log to disk */
 void profile_stop(void);
 
+/* write the collected data as collapsed stacks (for flamegraph tools)
+ * or as a pprof profile, tagged with the memory bank configuration
+ * returns -1 if there is no data or the file cannot be written */
+int profile_write_collapsed(const char *filename);
+int profile_write_pprof(const char *filename);
+
 /* called by the CPU for each instruction */
 void profile_sample_start(uint16_t pc);
 void profile_sample_finish(uint16_t cycle_time, uint16_t stolen_cycles);
@@ -72,6 +72,11 @@ typedef struct profiling_context_s {
 extern profiling_context_t  *root_context;
 extern profiling_context_t  *current_context;
 
+/* cycles each sample stands for, 0 if every instruction is accounted */
+extern unsigned int          profile_sample_interval;
+
+void                 profile_flush_samples(void);
+
 profiling_context_t *profile_context_by_id(int id);
 int                  get_context_id(profiling_context_t *context);
 void                 compute_aggregate_stats(profiling_context_t *context);
@@ -0,0 +1,413 @@
+/*
+ * profiler_export.c -- Export of CPU profiling data
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "lib.h"
+#include "profiler.h"
+#include "profiler_data.h"
+#include "types.h"
+#include "util.h"
+
+/* one more than the call stack the profiler keeps */
+#define MAX_EXPORT_DEPTH 130
+
+/* Frames are named like in the monitor, "ea31 {7}" for a function at $ea31
+ * entered with memory configuration 7, "IRQ ea31 {7}" if it was entered by
+ * an interrupt. Code outside of any call sits in "START". */
+
+typedef void (*export_sample_func_t)(profiling_context_t **stack, int depth,
+                                     uint16_t mem_config, uint16_t pc,
+                                     const profiling_data_t *data, void *param);
+
+static profiling_context_t *export_stack[MAX_EXPORT_DEPTH];
+
+static bool is_interrupt(uint16_t src)
+{
+    return src >= 0xfffa && !(src & 1);
+}
+
+static void context_name(char *buf, size_t size, profiling_context_t *context)
+{
+    const char *src = "";
+
+    if (context == NULL) {
+        snprintf(buf, size, "START");
+        return;
+    }
+
+    switch (context->pc_src) {
+        case 0xfffa: src = "NMI "; break;
+        case 0xfffc: src = "RST "; break;
+        case 0xfffe: src = "IRQ "; break;
+    }
+    snprintf(buf, size, "%s%04x {%u}", src, (unsigned)context->pc_dst,
+             (unsigned)context->memory_bank_config);
+}
+
+/* Call `func' for every instruction with samples. `stack' holds the contexts
+   from below the root down to the one the instruction ran in. */
+static void walk_context(profiling_context_t *context, int depth,
+                         export_sample_func_t func, void *param)
+{
+    profiling_context_t *c;
+    int i, j;
+
+    for (c = context; c != NULL; c = c->next_mem_config) {
+        for (i = 0; i < 256; i++) {
+            if (c->page[i] == NULL) {
+                continue;
+            }
+            for (j = 0; j < 256; j++) {
+                if (c->page[i]->data[j].num_samples != 0) {
+                    func(export_stack, depth, c->memory_bank_config,
+                         (uint16_t)((i << 8) | j), &c->page[i]->data[j], param);
+                }
+            }
+        }
+    }
+
+    if (context->child != NULL && depth < MAX_EXPORT_DEPTH) {
+        c = context->child;
+        do {
+            export_stack[depth] = c;
+            walk_context(c, depth + 1, func, param);
+            c = c->next;
+        } while (c != context->child);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* One line per instruction, "START;0810 {7};e544 {7};e55f {7} 1234" with
+   the cycles spent at the end, as taken by flamegraph.pl and friends. */
+static void write_collapsed_sample(profiling_context_t **stack, int depth,
+                                   uint16_t mem_config, uint16_t pc,
+                                   const profiling_data_t *data, void *param)
+{
+    FILE *fd = param;
+    char name[32];
+    int i;
+
+    if (depth == 0 || !is_interrupt(stack[0]->pc_src)) {
+        fputs("START;", fd);
+    }
+    for (i = 0; i < depth; i++) {
+        context_name(name, sizeof(name), stack[i]);
+        fprintf(fd, "%s;", name);
+    }
+    fprintf(fd, "%04x {%u} %u\n", (unsigned)pc, (unsigned)mem_config,
+            (unsigned)data->num_cycles);
+}
+
+int profile_write_collapsed(const char *filename)
+{
+    FILE *fd;
+
+    if (root_context == NULL) {
+        return -1;
+    }
+    profile_flush_samples();
+
+    fd = fopen(filename, MODE_WRITE_TEXT);
+    if (fd == NULL) {
+        return -1;
+    }
+    walk_context(root_context, 0, write_collapsed_sample, fd);
+    fclose(fd);
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Just enough protobuf to write the messages of pprof's profile.proto */
+
+#define PB_VARINT 0
+#define PB_LENGTH 2
+
+typedef struct pb_buffer_s {
+    uint8_t *data;
+    size_t len;
+    size_t size;
+} pb_buffer_t;
+
+static void pb_put(pb_buffer_t *pb, const void *data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    if (pb->len + len > pb->size) {
+        pb->size = (pb->len + len) * 2;
+        pb->data = lib_realloc(pb->data, pb->size);
+    }
+    memcpy(pb->data + pb->len, data, len);
+    pb->len += len;
+}
+
+static void pb_varint(pb_buffer_t *pb, uint64_t value)
+{
+    uint8_t buf[10];
+    size_t n = 0;
+
+    while (value >= 0x80) {
+        buf[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buf[n++] = (uint8_t)value;
+    pb_put(pb, buf, n);
+}
+
+/* zero is the default and left out */
+static void pb_uint(pb_buffer_t *pb, unsigned int field, uint64_t value)
+{
+    if (value != 0) {
+        pb_varint(pb, (field << 3) | PB_VARINT);
+        pb_varint(pb, value);
+    }
+}
+
+static void pb_bytes(pb_buffer_t *pb, unsigned int field, const void *data, size_t len)
+{
+    pb_varint(pb, (field << 3) | PB_LENGTH);
+    pb_varint(pb, len);
+    pb_put(pb, data, len);
+}
+
+/* append `msg' as field `field' of `pb', and empty it for the next one */
+static void pb_message(pb_buffer_t *pb, unsigned int field, pb_buffer_t *msg)
+{
+    pb_bytes(pb, field, msg->data, msg->len);
+    msg->len = 0;
+}
+
+/* Open addressing table handing out ids from 1 for 64 bit keys */
+typedef struct export_map_s {
+    uint64_t *keys;
+    uint32_t *ids;
+    uint32_t size;
+    uint32_t count;
+} export_map_t;
+
+static uint32_t map_slot(const export_map_t *map, uint64_t key)
+{
+    uint32_t i = (uint32_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & (map->size - 1);
+
+    while (map->ids[i] != 0 && map->keys[i] != key) {
+        i = (i + 1) & (map->size - 1);
+    }
+    return i;
+}
+
+static void map_grow(export_map_t *map)
+{
+    export_map_t old = *map;
+    uint32_t i, slot;
+
+    map->size = old.size ? old.size * 2 : 1024;
+    map->keys = lib_malloc(map->size * sizeof(*map->keys));
+    map->ids = lib_calloc(map->size, sizeof(*map->ids));
+    for (i = 0; i < old.size; i++) {
+        if (old.ids[i] != 0) {
+            slot = map_slot(map, old.keys[i]);
+            map->keys[slot] = old.keys[i];
+            map->ids[slot] = old.ids[i];
+        }
+    }
+    lib_free(old.keys);
+    lib_free(old.ids);
+}
+
+/* `*added' tells if the key was new */
+static uint32_t map_id(export_map_t *map, uint64_t key, bool *added)
+{
+    uint32_t slot;
+
+    if ((map->count + 1) * 2 > map->size) {
+        map_grow(map);
+    }
+    slot = map_slot(map, key);
+    *added = (map->ids[slot] == 0);
+    if (*added) {
+        map->keys[slot] = key;
+        map->ids[slot] = ++map->count;
+    }
+    return map->ids[slot];
+}
+
+static void map_free(export_map_t *map)
+{
+    lib_free(map->keys);
+    lib_free(map->ids);
+}
+
+/* String table indices written up front */
+enum {
+    PPROF_STR_EMPTY = 0,
+    PPROF_STR_SAMPLES,
+    PPROF_STR_COUNT,
+    PPROF_STR_CYCLES,
+    PPROF_STR_MEM_CONFIG
+};
+
+typedef struct pprof_export_s {
+    pb_buffer_t profile;    /* the Profile message */
+    pb_buffer_t msg;        /* message being built */
+    pb_buffer_t sub;        /* message nested in `msg' */
+    export_map_t functions;
+    export_map_t locations;
+    uint32_t num_strings;
+} pprof_export_t;
+
+static uint32_t pprof_string(pprof_export_t *pp, const char *str)
+{
+    pb_bytes(&pp->profile, 6, str, strlen(str));
+    return pp->num_strings++;
+}
+
+/* Function of `context', or of "START" for NULL */
+static uint32_t pprof_function(pprof_export_t *pp, profiling_context_t *context)
+{
+    char name[32];
+    uint64_t key;
+    uint32_t id, str;
+    bool added;
+
+    if (context == NULL) {
+        key = (uint64_t)1 << 48;
+    } else {
+        key = ((uint64_t)(is_interrupt(context->pc_src) ? context->pc_src : 0) << 32)
+              | ((uint64_t)context->memory_bank_config << 16) | context->pc_dst;
+    }
+
+    id = map_id(&pp->functions, key, &added);
+    if (added) {
+        context_name(name, sizeof(name), context);
+        str = pprof_string(pp, name);
+        pb_uint(&pp->msg, 1, id);
+        pb_uint(&pp->msg, 2, str);
+        pb_uint(&pp->msg, 3, str);
+        pb_message(&pp->profile, 5, &pp->msg);
+    }
+    return id;
+}
+
+/* Location of `addr' within a function. The memory configuration goes into
+   the upper address bits so that banked code gets locations of its own. */
+static uint32_t pprof_location(pprof_export_t *pp, uint32_t function_id,
+                               uint16_t mem_config, uint16_t addr)
+{
+    uint64_t key = ((uint64_t)function_id << 32) | ((uint32_t)mem_config << 16) | addr;
+    uint32_t id;
+    bool added;
+
+    id = map_id(&pp->locations, key, &added);
+    if (added) {
+        pb_uint(&pp->sub, 1, function_id);
+        pb_uint(&pp->msg, 1, id);
+        pb_uint(&pp->msg, 3, ((uint64_t)mem_config << 16) | addr);
+        pb_message(&pp->msg, 4, &pp->sub);
+        pb_message(&pp->profile, 4, &pp->msg);
+    }
+    return id;
+}
+
+static void pprof_sample(profiling_context_t **stack, int depth,
+                         uint16_t mem_config, uint16_t pc,
+                         const profiling_data_t *data, void *param)
+{
+    pprof_export_t *pp = param;
+    uint32_t ids[MAX_EXPORT_DEPTH + 1];
+    int n = 0, i;
+
+    /* leaf first, then the call sites up to the root */
+    ids[n++] = pprof_location(pp, pprof_function(pp, depth ? stack[depth - 1] : NULL),
+                              mem_config, pc);
+    for (i = depth - 1; i >= 0 && !is_interrupt(stack[i]->pc_src); i--) {
+        ids[n++] = pprof_location(pp, pprof_function(pp, i ? stack[i - 1] : NULL),
+                                  stack[i]->memory_bank_config,
+                                  (uint16_t)(stack[i]->pc_src - 2));
+    }
+
+    for (i = 0; i < n; i++) {
+        pb_varint(&pp->sub, ids[i]);
+    }
+    pb_message(&pp->msg, 1, &pp->sub);
+    pb_varint(&pp->sub, data->num_samples);
+    pb_varint(&pp->sub, data->num_cycles);
+    pb_message(&pp->msg, 2, &pp->sub);
+    pb_uint(&pp->sub, 1, PPROF_STR_MEM_CONFIG);
+    pb_uint(&pp->sub, 3, mem_config);
+    pb_message(&pp->msg, 3, &pp->sub);
+    pb_message(&pp->profile, 2, &pp->msg);
+}
+
+/* Written uncompressed, pprof takes both that and gzip. */
+int profile_write_pprof(const char *filename)
+{
+    pprof_export_t pp;
+    int ret;
+
+    if (root_context == NULL) {
+        return -1;
+    }
+    profile_flush_samples();
+
+    memset(&pp, 0, sizeof(pp));
+
+    pprof_string(&pp, "");
+    pprof_string(&pp, "samples");
+    pprof_string(&pp, "count");
+    pprof_string(&pp, "cycles");
+    pprof_string(&pp, "mem_config");
+
+    /* sample_type: samples/count, cycles/count */
+    pb_uint(&pp.msg, 1, PPROF_STR_SAMPLES);
+    pb_uint(&pp.msg, 2, PPROF_STR_COUNT);
+    pb_message(&pp.profile, 1, &pp.msg);
+    pb_uint(&pp.msg, 1, PPROF_STR_CYCLES);
+    pb_uint(&pp.msg, 2, PPROF_STR_COUNT);
+    pb_message(&pp.profile, 1, &pp.msg);
+
+    /* period_type, period, default_sample_type */
+    pb_uint(&pp.msg, 1, PPROF_STR_CYCLES);
+    pb_uint(&pp.msg, 2, PPROF_STR_COUNT);
+    pb_message(&pp.profile, 11, &pp.msg);
+    pb_uint(&pp.profile, 12, profile_sample_interval);
+    pb_uint(&pp.profile, 14, PPROF_STR_CYCLES);
+
+    walk_context(root_context, 0, pprof_sample, &pp);
+
+    ret = util_file_save(filename, pp.profile.data, (int)pp.profile.len);
+
+    lib_free(pp.profile.data);
+    lib_free(pp.msg.data);
+    lib_free(pp.sub.data);
+    map_free(&pp.functions);
+    map_free(&pp.locations);
+    return ret < 0 ? -1 : 0;
+}
@@ -44,7 +44,11 @@
 #include "viewport.h"
 
 #ifdef __LIBRETRO__
+#include <stdlib.h>
+
 #include "libretro-core.h"
+#include "video.h"
+#include "videoarch.h"
 #endif
 
 unsigned int raster_line_get_real_mode(raster_t *raster)
@@ -635,6 +639,58 @@ static void handle_visible_line_with_changes(raster_t *raster)
                      0, raster->geometry->screen_size.width - 1);
 }
 
+#ifdef __LIBRETRO__
+/* Flag whether the line just drawn shows anything besides the border, so
+   that auto crop does not have to scan the rendered frame for it.  A pixel
+   counts once the line has changed color noticeably, and only if it differs
+   from both border samples, which keeps flashing loader borders out.  The
+   colors compared are the low 16 bits of what the renderer puts out for
+   each palette index, with the threshold the scan of retro_bmp used.  */
+inline static void update_crop_content(raster_t *raster)
+{
+    const uint32_t *colors;
+    const uint8_t *p;
+    unsigned int line, row, x;
+    int ref, lb, rb, c, diff;
+    int found = 0;
+
+    if (!vice_raster.crop_xe || vice_raster.crop_canvas != raster->canvas
+        || retro_video_hidden) {
+        return;
+    }
+
+    line = map_current_line_to_area(raster);
+    if (line < raster->viewport->first_line) {
+        return;
+    }
+    row = line - raster->viewport->first_line;
+    if (row >= WINDOW_HEIGHT
+        || (row >= vice_raster.crop_top && row <= vice_raster.crop_bottom)) {
+        return;
+    }
+
+    colors = raster->canvas->videoconfig->color_tables.physical_colors;
+    diff = 1500 * pix_bytes;
+
+    p = raster->draw_buffer_ptr + raster->viewport->first_x;
+    ref = (uint16_t)colors[p[vice_raster.crop_xs]];
+    lb = (uint16_t)colors[p[vice_raster.crop_lb]];
+    rb = (uint16_t)colors[p[vice_raster.crop_rb]];
+
+    for (x = vice_raster.crop_xs; x < vice_raster.crop_xe; x++) {
+        c = (uint16_t)colors[p[x]];
+        if (abs(c - ref) > diff) {
+            found = 1;
+        }
+        if (found && c != lb && c != rb) {
+            break;
+        }
+    }
+
+    vice_raster.content[row] = (x < vice_raster.crop_xe);
+}
+#endif
+
 inline static void handle_visible_line(raster_t *raster)
 {
     if (raster->changes->have_on_this_line) {
@@ -692,6 +748,10 @@ void raster_line_emulate(raster_t *raster)
             raster->num_cached_lines = 0;
         }
 
+#ifdef __LIBRETRO__
+        update_crop_content(raster);
+#endif
+
 #if 0
         /* this is a fix for the pal emulation bug at the left/right edges */
         /* hacked, but other solutions would cause changes in many places in
@@ -32,6 +32,14 @@
 #include <fstream>
 using namespace std;
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESID_CONVOLVE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RESID_CONVOLVE_NEON
+#endif
+
 #ifndef round
 #define round(x) (x>=0.0?floor(x+0.5):ceil(x-0.5))
 #endif
@@ -938,6 +946,62 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n, int interlea
 }
 
 
+// ----------------------------------------------------------------------------
+// Filter convolution, sum(a[i]*b[i]) over n 16 bit samples.
+// The integer sum is exact, so the vector versions give the same result as
+// the plain loop.
+// ----------------------------------------------------------------------------
+static inline int convolve(const short* a, const short* b, int n)
+{
+  int v = 0;
+  int i = 0;
+
+#if defined(RESID_CONVOLVE_SSE2)
+  __m128i acc = _mm_setzero_si128();
+  for (; i + 8 <= n; i += 8) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+  }
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  v = _mm_cvtsi128_si32(acc);
+#elif defined(RESID_CONVOLVE_NEON)
+  int32x4_t acc = vdupq_n_s32(0);
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t va = vld1q_s16(a + i);
+    int16x8_t vb = vld1q_s16(b + i);
+    acc = vmlal_s16(acc, vget_low_s16(va), vget_low_s16(vb));
+    acc = vmlal_s16(acc, vget_high_s16(va), vget_high_s16(vb));
+  }
+  int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+  v = vget_lane_s32(vpadd_s32(sum, sum), 0);
+#endif
+
+  for (; i < n; i++) {
+    v += a[i]*b[i];
+  }
+
+  return v;
+}
+
+
+// ----------------------------------------------------------------------------
+// Number of output samples that can be computed in one block without the
+// ring buffer wrapping over the filter input of the first sample.
+// ----------------------------------------------------------------------------
+int SID::resample_block_size()
+{
+  int cycles = (cycles_per_sample >> FIXP_SHIFT) + 1;
+  int block = (RINGSIZE - fir_N - 2)/cycles;
+
+  if (block > RESAMPLE_BLOCK) {
+    block = RESAMPLE_BLOCK;
+  }
+  return block > 0 ? block : 1;
+}
+
+
 // ----------------------------------------------------------------------------
 // SID clocking with audio sampling - cycle based with audio resampling.
 //
@@ -957,6 +1021,11 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n, int interlea
 // of accuracy. The filter convolutions are also vectorizable on
 // current hardware.
 //
+// The chip is clocked for a block of output samples at a time, the
+// convolutions for the block are then run back to back using SSE2 or NEON
+// where available. This keeps the per cycle loop tight and the FIR tables
+// hot in the cache.
+//
 // Further possible optimizations are:
 // * An equiripple filter design could yield a lower filter order, see
 //   http://www.mwrf.com/Articles/ArticleID/7229/7229.html
@@ -976,62 +1045,79 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n, int interlea
 // ----------------------------------------------------------------------------
 int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
 {
-  int s;
+  int block_index[RESAMPLE_BLOCK];
+  cycle_count block_offset[RESAMPLE_BLOCK];
+  int max_block = resample_block_size();
+  int s = 0;
+
+  while (s < n) {
+    int block = n - s < max_block ? n - s : max_block;
+    bool done = false;
+    int b;
+
+    // Clock the chip for the whole block first, remembering where in the
+    // ring each output sample ends.
+    for (b = 0; b < block; b++) {
+      cycle_count next_sample_offset = sample_offset + cycles_per_sample;
+      cycle_count delta_t_sample = next_sample_offset >> FIXP_SHIFT;
+
+      if (delta_t_sample > delta_t) {
+        delta_t_sample = delta_t;
+      }
 
-  for (s = 0; s < n; s++) {
-    cycle_count next_sample_offset = sample_offset + cycles_per_sample;
-    cycle_count delta_t_sample = next_sample_offset >> FIXP_SHIFT;
+      for (int i = 0; i < delta_t_sample; i++) {
+        clock();
+        sample[sample_index] = sample[sample_index + RINGSIZE] = clip(output());
+        ++sample_index &= RINGMASK;
+      }
 
-    if (delta_t_sample > delta_t) {
-      delta_t_sample = delta_t;
-    }
+      if ((delta_t -= delta_t_sample) == 0) {
+        sample_offset -= delta_t_sample << FIXP_SHIFT;
+        done = true;
+        break;
+      }
 
-    for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = clip(output());
-      ++sample_index &= RINGMASK;
-    }
+      sample_offset = next_sample_offset & FIXP_MASK;
 
-    if ((delta_t -= delta_t_sample) == 0) {
-      sample_offset -= delta_t_sample << FIXP_SHIFT;
-      break;
+      block_index[b] = sample_index;
+      block_offset[b] = sample_offset;
     }
 
-    sample_offset = next_sample_offset & FIXP_MASK;
+    // Then run the filter convolutions over the block.
+    for (int k = 0; k < b; k++) {
+      int fir_offset = block_offset[k]*fir_RES >> FIXP_SHIFT;
+      int fir_offset_rmd = block_offset[k]*fir_RES & FIXP_MASK;
+      short* fir_start = fir + fir_offset*fir_N;
+      short* sample_start = sample + block_index[k] - fir_N - 1 + RINGSIZE;
+
+      // Convolution with filter impulse response.
+      int v1 = convolve(sample_start, fir_start, fir_N);
+
+      // Use next FIR table, wrap around to first FIR table using
+      // next sample.
+      if (unlikely(++fir_offset == fir_RES)) {
+        fir_offset = 0;
+        ++sample_start;
+      }
+      fir_start = fir + fir_offset*fir_N;
 
-    int fir_offset = sample_offset*fir_RES >> FIXP_SHIFT;
-    int fir_offset_rmd = sample_offset*fir_RES & FIXP_MASK;
-    short* fir_start = fir + fir_offset*fir_N;
-    short* sample_start = sample + sample_index - fir_N - 1 + RINGSIZE;
+      // Convolution with filter impulse response.
+      int v2 = convolve(sample_start, fir_start, fir_N);
 
-    // Convolution with filter impulse response.
-    int v1 = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v1 += sample_start[j]*fir_start[j];
-    }
+      // Linear interpolation.
+      // fir_offset_rmd is equal for all samples, it can thus be factorized out:
+      // sum(v1 + rmd*(v2 - v1)) = sum(v1) + rmd*(sum(v2) - sum(v1))
+      int v = v1 + int((unsigned(fir_offset_rmd)*unsigned(v2 - v1)) >> FIXP_SHIFT);
 
-    // Use next FIR table, wrap around to first FIR table using
-    // next sample.
-    if (unlikely(++fir_offset == fir_RES)) {
-      fir_offset = 0;
-      ++sample_start;
-    }
-    fir_start = fir + fir_offset*fir_N;
+      v >>= FIR_SHIFT;
 
-    // Convolution with filter impulse response.
-    int v2 = 0;
-    for (int k = 0; k < fir_N; k++) {
-      v2 += sample_start[k]*fir_start[k];
+      buf[(s + k)*interleave] = amplify(v, scaleFactor);
     }
 
-    // Linear interpolation.
-    // fir_offset_rmd is equal for all samples, it can thus be factorized out:
-    // sum(v1 + rmd*(v2 - v1)) = sum(v1) + rmd*(sum(v2) - sum(v1))
-    int v = v1 + int((unsigned(fir_offset_rmd)*unsigned(v2 - v1)) >> FIXP_SHIFT);
-
-    v >>= FIR_SHIFT;
-
-    buf[s*interleave] = amplify(v, scaleFactor);
+    s += b;
+    if (done) {
+      break;
+    }
   }
 
   return s;
@@ -1043,42 +1129,59 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
 // ----------------------------------------------------------------------------
 int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int interleave)
 {
-  int s;
+  int block_index[RESAMPLE_BLOCK];
+  cycle_count block_offset[RESAMPLE_BLOCK];
+  int max_block = resample_block_size();
+  int s = 0;
+
+  while (s < n) {
+    int block = n - s < max_block ? n - s : max_block;
+    bool done = false;
+    int b;
+
+    for (b = 0; b < block; b++) {
+      cycle_count next_sample_offset = sample_offset + cycles_per_sample;
+      cycle_count delta_t_sample = next_sample_offset >> FIXP_SHIFT;
+
+      if (delta_t_sample > delta_t) {
+        delta_t_sample = delta_t;
+      }
 
-  for (s = 0; s < n; s++) {
-    cycle_count next_sample_offset = sample_offset + cycles_per_sample;
-    cycle_count delta_t_sample = next_sample_offset >> FIXP_SHIFT;
+      for (int i = 0; i < delta_t_sample; i++) {
+        clock();
+        sample[sample_index] = sample[sample_index + RINGSIZE] = clip(output());
+        ++sample_index &= RINGMASK;
+      }
 
-    if (delta_t_sample > delta_t) {
-      delta_t_sample = delta_t;
-    }
+      if ((delta_t -= delta_t_sample) == 0) {
+        sample_offset -= delta_t_sample << FIXP_SHIFT;
+        done = true;
+        break;
+      }
 
-    for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = clip(output());
-      ++sample_index &= RINGMASK;
-    }
+      sample_offset = next_sample_offset & FIXP_MASK;
 
-    if ((delta_t -= delta_t_sample) == 0) {
-      sample_offset -= delta_t_sample << FIXP_SHIFT;
-      break;
+      block_index[b] = sample_index;
+      block_offset[b] = sample_offset;
     }
 
-    sample_offset = next_sample_offset & FIXP_MASK;
+    for (int k = 0; k < b; k++) {
+      int fir_offset = block_offset[k]*fir_RES >> FIXP_SHIFT;
+      short* fir_start = fir + fir_offset*fir_N;
+      short* sample_start = sample + block_index[k] - fir_N + RINGSIZE;
 
-    int fir_offset = sample_offset*fir_RES >> FIXP_SHIFT;
-    short* fir_start = fir + fir_offset*fir_N;
-    short* sample_start = sample + sample_index - fir_N + RINGSIZE;
+      // Convolution with filter impulse response.
+      int v = convolve(sample_start, fir_start, fir_N);
 
-    // Convolution with filter impulse response.
-    int v = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v += sample_start[j]*fir_start[j];
-    }
+      v >>= FIR_SHIFT;
 
-    v >>= FIR_SHIFT;
+      buf[(s + k)*interleave] = amplify(v, scaleFactor);
+    }
 
-    buf[s*interleave] = amplify(v, scaleFactor);
+    s += b;
+    if (done) {
+      break;
+    }
   }
 
   return s;
@@ -109,6 +109,7 @@ public:
   int clock_interpolate(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_resample(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int interleave);
+  int resample_block_size();
   void write();
 
   chip_model sid_model;
@@ -149,6 +150,9 @@ public:
     RINGSIZE = 1 << 14,
     RINGMASK = RINGSIZE - 1,
 
+    // Maximum number of output samples clocked ahead of the convolutions.
+    RESAMPLE_BLOCK = 64,
+
     // Fixed point constants (16.16 bits).
     FIXP_SHIFT = 16,
     FIXP_MASK = 0xffff
@@ -63,26 +63,27 @@ struct sound_s
 
     /* resid sid implementation */
     reSID::SID *sid;
+
+    /* temporary buffer, kept per chip since several chips may be rendered
+       at the same time */
+    short *buf;
+    int blen;
 };
 
 typedef struct sound_s sound_t;
 
 /* manage temporary buffers. if the requested size is smaller or equal to the
  * size of the already allocated buffer, reuse it.  */
-static short *buf = NULL;
-
-static int blen = 0;
-
-static short *getbuf(int len)
+static short *getbuf(sound_t *psid, int len)
 {
-    if ((buf == NULL) || (blen < len)) {
-        if (buf) {
-            lib_free(buf);
+    if ((psid->buf == NULL) || (psid->blen < len)) {
+        if (psid->buf) {
+            lib_free(psid->buf);
         }
-        blen = len;
-        buf = (short *)lib_calloc(len, 1);
+        psid->blen = len;
+        psid->buf = (short *)lib_calloc(len, 1);
     }
-    return buf;
+    return psid->buf;
 }
 
 static sound_t *resid_open(uint8_t *sidstate)
@@ -92,6 +93,8 @@ static sound_t *resid_open(uint8_t *sidstate)
 
     psid = new sound_t;
     psid->sid = new reSID::SID;
+    psid->buf = NULL;
+    psid->blen = 0;
 
     for (i = 0x00; i <= 0x18; i++) {
         psid->sid->write(i, sidstate[i]);
@@ -239,13 +242,11 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec, int factor)
 
 static void resid_close(sound_t *psid)
 {
+    if (psid->buf) {
+        lib_free(psid->buf);
+    }
     delete psid->sid;
     delete psid;
-
-    if (buf) {
-        lib_free(buf);
-        buf = NULL;
-    }
 }
 
 static uint8_t resid_read(sound_t *psid, uint16_t addr)
@@ -276,7 +277,7 @@ static int resid_calculate_samples(sound_t *psid, float *pbuf, int nr, CLOCK *de
     /* Tried not to mess with resid during 64-bit conversion. clock(...) wants to modify *delta_t ... */
 
     if (psid->factor == 1000) {
-        tmp_buf = getbuf(2 * nr);
+        tmp_buf = getbuf(psid, 2 * nr);
         retval = psid->sid->clock(int_delta_t, tmp_buf, nr, 0);
         (*delta_t) += int_delta_t - int_delta_t_original;
         for (i = 0; i < nr; i++) {
@@ -285,7 +286,7 @@ static int resid_calculate_samples(sound_t *psid, float *pbuf, int nr, CLOCK *de
         return retval;
     }
 
-    tmp_buf = getbuf(2 * nr * psid->factor / 1000);
+    tmp_buf = getbuf(psid, 2 * nr * psid->factor / 1000);
     retval = psid->sid->clock(int_delta_t, tmp_buf, nr * psid->factor / 1000, 0) * 1000 / psid->factor;
     (*delta_t) += int_delta_t - int_delta_t_original;
     for (i = 0; i < nr; i++) {
@@ -310,7 +311,7 @@ static int resid_calculate_samples(sound_t *psid, short *pbuf, int nr, int inter
         return retval;
     }
 
-    tmp_buf = getbuf(2 * nr * psid->factor / 1000);
+    tmp_buf = getbuf(psid, 2 * nr * psid->factor / 1000);
     retval = psid->sid->clock(int_delta_t, tmp_buf, nr * psid->factor / 1000, interleave) * 1000 / psid->factor;
     (*delta_t) += int_delta_t - int_delta_t_original;
     memcpy(pbuf, tmp_buf, 2 * nr);
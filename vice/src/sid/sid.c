@@ -638,6 +638,104 @@ GETBUFx(7)
 
 #endif
 
+#ifndef SOUND_SYSTEM_FLOAT
+/* Multiple SIDs are rendered independently of each other into their own
+   buffers and only mixed afterwards, so all but the last chip of a call are
+   queued here and may be run on a thread pool while the calling thread
+   renders the last one.  */
+typedef struct sid_job_s {
+    sound_t *psid;
+    int16_t *pbuf;
+    int nr;
+    int interleave;
+    CLOCK delta_t;
+} sid_job_t;
+
+#if defined(__LIBRETRO__) && defined(HAVE_THREADS)
+#include "rthreads/tpool.h"
+
+/* Calls for fewer samples than this are rendered in place, waking up the
+   pool costs more than rendering them.  */
+#define SID_JOB_MIN_SAMPLES 64
+
+static sid_job_t sid_jobs[SOUND_SIDS_MAX];
+static int sid_jobs_num = 0;
+static tpool_t *sid_pool = NULL;
+static int sid_threads_enabled = 0;
+
+static void sid_job_func(void *arg)
+{
+    sid_job_t *job = (sid_job_t *)arg;
+
+    sid_engine.calculate_samples(job->psid, job->pbuf, job->nr, job->interleave, &job->delta_t);
+}
+
+/* The pool is only created and destroyed here. Samples are only rendered
+   on the thread running the emulation, which is also the one changing the
+   option, so no job can be in flight meanwhile.  */
+void sid_threads_set(int enable)
+{
+    if (enable && sid_pool == NULL) {
+        sid_pool = tpool_create(SOUND_SIDS_MAX - 1);
+    } else if (!enable && sid_pool != NULL) {
+        tpool_destroy(sid_pool);
+        sid_pool = NULL;
+    }
+    sid_threads_enabled = (sid_pool != NULL);
+}
+
+static void sid_calculate_samples_queue(sound_t *psid, int16_t *pbuf, int nr, int interleave, CLOCK delta_t)
+{
+    sid_job_t *job = &sid_jobs[sid_jobs_num++];
+
+    job->psid = psid;
+    job->pbuf = pbuf;
+    job->nr = nr;
+    job->interleave = interleave;
+    job->delta_t = delta_t;
+}
+
+static int sid_calculate_samples_run(sound_t *psid, int16_t *pbuf, int nr, int interleave, CLOCK *delta_t)
+{
+    int i, retval;
+    int threaded = 0;
+
+    if (sid_threads_enabled && sid_jobs_num > 0 && nr >= SID_JOB_MIN_SAMPLES) {
+        threaded = 1;
+        for (i = 0; i < sid_jobs_num; i++) {
+            if (!tpool_add_work(sid_pool, sid_job_func, &sid_jobs[i])) {
+                sid_job_func(&sid_jobs[i]);
+            }
+        }
+    }
+    if (!threaded) {
+        for (i = 0; i < sid_jobs_num; i++) {
+            sid_job_func(&sid_jobs[i]);
+        }
+    }
+
+    retval = sid_engine.calculate_samples(psid, pbuf, nr, interleave, delta_t);
+
+    if (threaded) {
+        tpool_wait(sid_pool);
+    }
+    sid_jobs_num = 0;
+
+    return retval;
+}
+#else
+static void sid_calculate_samples_queue(sound_t *psid, int16_t *pbuf, int nr, int interleave, CLOCK delta_t)
+{
+    sid_engine.calculate_samples(psid, pbuf, nr, interleave, &delta_t);
+}
+
+static int sid_calculate_samples_run(sound_t *psid, int16_t *pbuf, int nr, int interleave, CLOCK *delta_t)
+{
+    return sid_engine.calculate_samples(psid, pbuf, nr, interleave, delta_t);
+}
+#endif
+#endif
+
 int sid_sound_machine_init_vbr(sound_t *psid, int speed, int cycles_per_sec, int factor)
 {
     return sid_engine.init(psid, speed * factor / 1000, cycles_per_sec, factor);
@@ -733,15 +831,14 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
     int16_t *tmp_buf6;
     int16_t *tmp_buf7;
     int tmp_nr = 0;
-    CLOCK tmp_delta_t = *delta_t;
 
     if (soc == SOUND_OUTPUT_MONO && scc == SOUND_1_DEVICE) {
         return sid_engine.calculate_samples(psid[0], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
     }
     if (soc == SOUND_OUTPUT_MONO && scc == SOUND_2_DEVICES) {
         tmp_buf1 = getbuf1(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
+        sid_calculate_samples_queue(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
         }
@@ -750,10 +847,9 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
     if (soc == SOUND_OUTPUT_MONO && scc == SOUND_3_DEVICES) {
         tmp_buf1 = getbuf1(2 * nr);
         tmp_buf2 = getbuf2(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
+        sid_calculate_samples_queue(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf2[i]);
@@ -764,12 +860,10 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
         tmp_buf1 = getbuf1(2 * nr);
         tmp_buf2 = getbuf2(2 * nr);
         tmp_buf3 = getbuf3(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf3, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
+        sid_calculate_samples_queue(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[3], tmp_buf3, nr, SOUND_OUTPUT_MONO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf2[i]);
@@ -782,14 +876,11 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
         tmp_buf2 = getbuf2(2 * nr);
         tmp_buf3 = getbuf3(2 * nr);
         tmp_buf4 = getbuf4(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf3, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[4], tmp_buf4, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
+        sid_calculate_samples_queue(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[3], tmp_buf3, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[4], tmp_buf4, nr, SOUND_OUTPUT_MONO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf2[i]);
@@ -804,16 +895,12 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
         tmp_buf3 = getbuf3(2 * nr);
         tmp_buf4 = getbuf4(2 * nr);
         tmp_buf5 = getbuf5(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf3, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[4], tmp_buf4, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[5], tmp_buf5, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
+        sid_calculate_samples_queue(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[3], tmp_buf3, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[4], tmp_buf4, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[5], tmp_buf5, nr, SOUND_OUTPUT_MONO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf2[i]);
@@ -830,18 +917,13 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
         tmp_buf4 = getbuf4(2 * nr);
         tmp_buf5 = getbuf5(2 * nr);
         tmp_buf6 = getbuf6(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf3, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[4], tmp_buf4, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[5], tmp_buf5, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[6], tmp_buf6, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
+        sid_calculate_samples_queue(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[3], tmp_buf3, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[4], tmp_buf4, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[5], tmp_buf5, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[6], tmp_buf6, nr, SOUND_OUTPUT_MONO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf2[i]);
@@ -860,20 +942,14 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
         tmp_buf5 = getbuf5(2 * nr);
         tmp_buf6 = getbuf6(2 * nr);
         tmp_buf7 = getbuf7(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf3, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[4], tmp_buf4, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[5], tmp_buf5, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[6], tmp_buf6, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[7], tmp_buf7, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
+        sid_calculate_samples_queue(psid[0], tmp_buf1, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf2, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[3], tmp_buf3, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[4], tmp_buf4, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[5], tmp_buf5, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[6], tmp_buf6, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[7], tmp_buf7, nr, SOUND_OUTPUT_MONO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf2[i]);
@@ -893,16 +969,15 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
         return tmp_nr;
     }
     if (soc == SOUND_OUTPUT_STEREO && scc == SOUND_2_DEVICES) {
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
+        sid_calculate_samples_queue(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
         return tmp_nr;
     }
     if (soc == SOUND_OUTPUT_STEREO && scc == SOUND_3_DEVICES) {
         tmp_buf1 = getbuf1(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf1, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf1, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf1[i]);
             pbuf[(i * 2) + 1] = sound_audio_mix(pbuf[(i * 2) + 1], tmp_buf1[i]);
@@ -910,12 +985,10 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
     }
     if (soc == SOUND_OUTPUT_STEREO && scc == SOUND_4_DEVICES) {
         tmp_buf1 = getbuf1(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf1 + 1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[3], tmp_buf1 + 1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf1[i * 2]);
             pbuf[(i * 2) + 1] = sound_audio_mix(pbuf[(i * 2) + 1], tmp_buf1[(i * 2) + 1]);
@@ -924,14 +997,11 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
     if (soc == SOUND_OUTPUT_STEREO && scc == SOUND_5_DEVICES) {
         tmp_buf1 = getbuf1(2 * nr);
         tmp_buf2 = getbuf2(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf1 + 1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[4], tmp_buf2, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[3], tmp_buf1 + 1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[4], tmp_buf2, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf1[i * 2]);
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf2[i]);
@@ -942,16 +1012,12 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
     if (soc == SOUND_OUTPUT_STEREO && scc == SOUND_6_DEVICES) {
         tmp_buf1 = getbuf1(2 * nr);
         tmp_buf2 = getbuf2(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf1 + 1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[4], tmp_buf2, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[5], tmp_buf2 + 1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[3], tmp_buf1 + 1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[4], tmp_buf2, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[5], tmp_buf2 + 1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf1[i * 2]);
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf2[i * 2]);
@@ -963,18 +1029,13 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
         tmp_buf1 = getbuf1(2 * nr);
         tmp_buf2 = getbuf2(2 * nr);
         tmp_buf3 = getbuf3(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf1 + 1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[4], tmp_buf2, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[5], tmp_buf2 + 1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[6], tmp_buf3, nr, SOUND_OUTPUT_MONO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[3], tmp_buf1 + 1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[4], tmp_buf2, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[5], tmp_buf2 + 1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[6], tmp_buf3, nr, SOUND_OUTPUT_MONO, *delta_t);
+        sid_calculate_samples_queue(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf1[i * 2]);
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf2[i * 2]);
@@ -988,20 +1049,14 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
         tmp_buf1 = getbuf1(2 * nr);
         tmp_buf2 = getbuf2(2 * nr);
         tmp_buf3 = getbuf3(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf1 + 1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[4], tmp_buf2, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[5], tmp_buf2 + 1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[6], tmp_buf3, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[7], tmp_buf3 + 1, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
+        sid_calculate_samples_queue(psid[2], tmp_buf1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[3], tmp_buf1 + 1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[4], tmp_buf2, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[5], tmp_buf2 + 1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[6], tmp_buf3, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[7], tmp_buf3 + 1, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        sid_calculate_samples_queue(psid[0], pbuf, nr, SOUND_OUTPUT_STEREO, *delta_t);
+        tmp_nr = sid_calculate_samples_run(psid[1], pbuf + 1, nr, SOUND_OUTPUT_STEREO, delta_t);
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf1[i * 2]);
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf2[i * 2]);
@@ -274,6 +274,9 @@ int sid_sound_machine_calculate_samples(sound_t **psid, float *pbuf, int nr, int
 #else
 int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, int sound_output_channels, int sound_chip_channels, CLOCK *delta_t);
 #endif
+#if defined(__LIBRETRO__) && defined(HAVE_THREADS) && !defined(SOUND_SYSTEM_FLOAT)
+void sid_threads_set(int enable);
+#endif
 
 void sid_set_enable(int value);
 
@@ -455,6 +455,12 @@ int snapshot_module_write_byte_array(snapshot_module_t *m, const uint8_t *b, uns
     return 0;
 }
 
+/* Files are always written in full */
+int snapshot_module_write_dirty_byte_array(snapshot_module_t *m, const uint8_t *b, unsigned int num, dirty_map_t *map)
+{
+    return snapshot_module_write_byte_array(m, b, num);
+}
+
 int snapshot_module_write_word_array(snapshot_module_t *m, const uint16_t *w, unsigned int num)
 {
     if (snapshot_write_word_array(m->file, w, num) < 0) {
@@ -32,6 +32,7 @@
 #ifndef SNAPSHOT_H
 #define SNAPSHOT_H
 
+#include "dirtymap.h"
 #include "types.h"
 
 #define SNAPSHOT_MACHINE_NAME_LEN       16
@@ -81,6 +82,7 @@ int snapshot_module_write_qword(snapshot_module_t *m, uint64_t data);
 int snapshot_module_write_double(snapshot_module_t *m, double db);
 int snapshot_module_write_padded_string(snapshot_module_t *m, const char *s, uint8_t pad_char, int len);
 int snapshot_module_write_byte_array(snapshot_module_t *m, const uint8_t *data, unsigned int num);
+int snapshot_module_write_dirty_byte_array(snapshot_module_t *m, const uint8_t *data, unsigned int num, dirty_map_t *map);
 int snapshot_module_write_word_array(snapshot_module_t *m, const uint16_t *data, unsigned int num);
 int snapshot_module_write_dword_array(snapshot_module_t *m, const uint32_t *data, unsigned int num);
 int snapshot_module_write_string(snapshot_module_t *m, const char *s);
@@ -110,6 +112,7 @@ int snapshot_module_read_qword_into_int64(snapshot_module_t *m, int64_t *value_r
 #define SMW_DB       snapshot_module_write_double
 #define SMW_PSTR     snapshot_module_write_padded_string
 #define SMW_BA       snapshot_module_write_byte_array
+#define SMW_DBA      snapshot_module_write_dirty_byte_array
 #define SMW_WA       snapshot_module_write_word_array
 #define SMW_DWA      snapshot_module_write_dword_array
 #define SMW_STR      snapshot_module_write_string
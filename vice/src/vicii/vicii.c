@@ -266,6 +266,23 @@ void vicii_handle_pending_alarms_external(CLOCK num_write_cycles)
     }
 }
 
+/*
+ * First clock at which vicii_handle_pending_alarms(0) has anything to do,
+ * before that calling it is a no-op. Used by DMA engines that want to move
+ * several bytes at once.
+ */
+CLOCK vicii_pending_alarms_clk(void)
+{
+    if (!vicii.initialized) {
+        return CLOCK_MAX;
+    }
+    if (vicii.viciie != 0) {
+        /* the 2MHz delay has to be checked on every call */
+        return maincpu_clk;
+    }
+    return (vicii.fetch_clk < vicii.draw_clk) ? vicii.fetch_clk : vicii.draw_clk;
+}
+
 /*
  * As mentioned elsewhere, BA won't interrupt the CPU's write cycles, but it can
  * stop it at read cycles.
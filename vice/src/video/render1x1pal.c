@@ -30,6 +30,14 @@
 #include "types.h"
 #include "video-color.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RENDER_PAL_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RENDER_PAL_NEON
+#endif
+
 /*
     YUV to RGB
 
@@ -46,44 +54,184 @@ void yuv_to_rgb(int32_t y, int32_t u, int32_t v,
     *grn = (y - ((50 * u + 130 * v) >> 8)) >> 16;
 }
 
-#ifdef __LIBRETRO__
+/*
+    A scanline is rendered in three passes, so the arithmetic in the middle
+    can run four pixels at a time:
+
+    1. look up the chroma and luma contributions of every source pixel once
+       (the filter used to look up each of them four times)
+    2. sum the four pixel chroma window, blend it with the delay line and
+       convert to RGB table indices
+    3. pack the gamma corrected components into the target
+*/
+
+typedef struct pal_line_s {
+    int32_t cb[VIDEO_MAX_OUTPUT_WIDTH + 4];
+    int32_t cr[VIDEO_MAX_OUTPUT_WIDTH + 4];
+    int32_t yl[VIDEO_MAX_OUTPUT_WIDTH + 4];
+    int32_t yh[VIDEO_MAX_OUTPUT_WIDTH + 4];
+    int32_t red[VIDEO_MAX_OUTPUT_WIDTH];
+    int32_t grn[VIDEO_MAX_OUTPUT_WIDTH];
+    int32_t blu[VIDEO_MAX_OUTPUT_WIDTH];
+} pal_line_t;
+
+static inline
+void pal_fetch_line(pal_line_t *pl, const uint8_t *src, unsigned int n,
+                    const int32_t *cbtable, const int32_t *crtable,
+                    const int32_t *ytablel, const int32_t *ytableh)
+{
+    unsigned int i;
+
+    for (i = 0; i < n + 3; i++) {
+        uint8_t c = src[i];
+
+        pl->cb[i] = cbtable[c];
+        pl->cr[i] = crtable[c];
+        pl->yl[i] = ytablel[c];
+        pl->yh[i] = ytableh[c];
+    }
+}
+
+/* chroma of the previous line, for the delay line */
+static inline
+void pal_chroma_line(const pal_line_t *pl, unsigned int n,
+                     int32_t *line_u, int32_t *line_v)
+{
+    unsigned int x;
+
+    for (x = 0; x < n; x++) {
+        line_u[x] = pl->cb[x] + pl->cb[x + 1] + pl->cb[x + 2] + pl->cb[x + 3];
+        line_v[x] = pl->cr[x] + pl->cr[x + 1] + pl->cr[x + 2] + pl->cr[x + 3];
+    }
+}
+
+#if defined(RENDER_PAL_SSE2)
+/* SSE2 lacks a 32 bit multiply, the low halves of two 32x32->64 multiplies
+   give the same result modulo 2^32 */
+static inline __m128i pal_mullo_epi32(__m128i a, __m128i b)
+{
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+#endif
+
 static inline
-void store_pixel_2(video_render_color_tables_t *color_tab, uint8_t *trg, int32_t y1, int32_t u1, int32_t v1, int32_t y2, int32_t u2, int32_t v2)
+void pal_rgb_line(pal_line_t *pl, unsigned int n, int32_t off_flip,
+                  int32_t *line_u, int32_t *line_v)
 {
-    uint16_t *tmp;
-    int32_t red;
-    int32_t grn;
-    int32_t blu;
+    int32_t *red = pl->red;
+    int32_t *grn = pl->grn;
+    int32_t *blu = pl->blu;
+    unsigned int x = 0;
+
+#if defined(RENDER_PAL_SSE2)
+    const __m128i flip = _mm_set1_epi32(off_flip);
+
+    for (; x + 4 <= n; x += 4) {
+        __m128i unew, vnew, l, u, v, g;
 
-    yuv_to_rgb(y1, u1, v1, &red, &grn, &blu);
-    tmp = (uint16_t *) trg;
-    tmp[0] = (uint16_t) (color_tab->gamma_red[256 + red] | color_tab->gamma_grn[256 + grn] | color_tab->gamma_blu[256 + blu]);
+        unew = _mm_add_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i *)(pl->cb + x)),
+                                           _mm_loadu_si128((const __m128i *)(pl->cb + x + 1))),
+                             _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pl->cb + x + 2)),
+                                           _mm_loadu_si128((const __m128i *)(pl->cb + x + 3))));
+        vnew = _mm_add_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i *)(pl->cr + x)),
+                                           _mm_loadu_si128((const __m128i *)(pl->cr + x + 1))),
+                             _mm_add_epi32(_mm_loadu_si128((const __m128i *)(pl->cr + x + 2)),
+                                           _mm_loadu_si128((const __m128i *)(pl->cr + x + 3))));
+        l = _mm_add_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i *)(pl->yl + x + 1)),
+                                        _mm_loadu_si128((const __m128i *)(pl->yh + x + 2))),
+                          _mm_loadu_si128((const __m128i *)(pl->yl + x + 3)));
 
-    yuv_to_rgb(y2, u2, v2, &red, &grn, &blu);
-    tmp[1] = (uint16_t) (color_tab->gamma_red[256 + red] | color_tab->gamma_grn[256 + grn] | color_tab->gamma_blu[256 + blu]);
+        u = pal_mullo_epi32(_mm_add_epi32(unew, _mm_loadu_si128((const __m128i *)(line_u + x))), flip);
+        v = pal_mullo_epi32(_mm_add_epi32(vnew, _mm_loadu_si128((const __m128i *)(line_v + x))), flip);
+        _mm_storeu_si128((__m128i *)(line_u + x), unew);
+        _mm_storeu_si128((__m128i *)(line_v + x), vnew);
+
+        /* 50 * u + 130 * v */
+        g = _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(u, 5), _mm_slli_epi32(u, 4)),
+                          _mm_add_epi32(_mm_slli_epi32(u, 1), _mm_slli_epi32(v, 7)));
+        g = _mm_add_epi32(g, _mm_slli_epi32(v, 1));
+
+        _mm_storeu_si128((__m128i *)(red + x), _mm_srai_epi32(_mm_add_epi32(l, v), 16));
+        _mm_storeu_si128((__m128i *)(blu + x), _mm_srai_epi32(_mm_add_epi32(l, u), 16));
+        _mm_storeu_si128((__m128i *)(grn + x), _mm_srai_epi32(_mm_sub_epi32(l, _mm_srai_epi32(g, 8)), 16));
+    }
+#elif defined(RENDER_PAL_NEON)
+    const int32x4_t flip = vdupq_n_s32(off_flip);
+
+    for (; x + 4 <= n; x += 4) {
+        int32x4_t unew, vnew, l, u, v, g;
+
+        unew = vaddq_s32(vaddq_s32(vld1q_s32(pl->cb + x), vld1q_s32(pl->cb + x + 1)),
+                         vaddq_s32(vld1q_s32(pl->cb + x + 2), vld1q_s32(pl->cb + x + 3)));
+        vnew = vaddq_s32(vaddq_s32(vld1q_s32(pl->cr + x), vld1q_s32(pl->cr + x + 1)),
+                         vaddq_s32(vld1q_s32(pl->cr + x + 2), vld1q_s32(pl->cr + x + 3)));
+        l = vaddq_s32(vaddq_s32(vld1q_s32(pl->yl + x + 1), vld1q_s32(pl->yh + x + 2)),
+                      vld1q_s32(pl->yl + x + 3));
+
+        u = vmulq_s32(vaddq_s32(unew, vld1q_s32(line_u + x)), flip);
+        v = vmulq_s32(vaddq_s32(vnew, vld1q_s32(line_v + x)), flip);
+        vst1q_s32(line_u + x, unew);
+        vst1q_s32(line_v + x, vnew);
+
+        g = vmlaq_n_s32(vmulq_n_s32(u, 50), v, 130);
+
+        vst1q_s32(red + x, vshrq_n_s32(vaddq_s32(l, v), 16));
+        vst1q_s32(blu + x, vshrq_n_s32(vaddq_s32(l, u), 16));
+        vst1q_s32(grn + x, vshrq_n_s32(vsubq_s32(l, vshrq_n_s32(g, 8)), 16));
+    }
+#endif
+
+    for (; x < n; x++) {
+        int32_t l, unew, vnew, u, v;
+
+        unew = pl->cb[x] + pl->cb[x + 1] + pl->cb[x + 2] + pl->cb[x + 3];
+        vnew = pl->cr[x] + pl->cr[x + 1] + pl->cr[x + 2] + pl->cr[x + 3];
+        l = pl->yl[x + 1] + pl->yh[x + 2] + pl->yl[x + 3];
+        u = (unew + line_u[x]) * off_flip;
+        v = (vnew + line_v[x]) * off_flip;
+        line_u[x] = unew;
+        line_v[x] = vnew;
+        yuv_to_rgb(l, u, v, &red[x], &grn[x], &blu[x]);
+    }
+}
+
+#ifdef __LIBRETRO__
+static inline
+void store_line_2(video_render_color_tables_t *color_tab, uint8_t *trg, unsigned int n,
+                  const pal_line_t *pl)
+{
+    const int32_t *red = pl->red;
+    const int32_t *grn = pl->grn;
+    const int32_t *blu = pl->blu;
+    uint16_t *tmp = (uint16_t *)trg;
+    unsigned int x;
+
+    for (x = 0; x < n; x++) {
+        tmp[x] = (uint16_t) (color_tab->gamma_red[256 + red[x]] | color_tab->gamma_grn[256 + grn[x]] | color_tab->gamma_blu[256 + blu[x]]);
+    }
 }
 #endif
 
 static inline
-void store_pixel_4(video_render_color_tables_t *color_tab, uint8_t *trg, int32_t y1, int32_t u1, int32_t v1, int32_t y2, int32_t u2, int32_t v2)
+void store_line_4(video_render_color_tables_t *color_tab, uint8_t *trg, unsigned int n,
+                  const pal_line_t *pl)
 {
-    uint32_t *tmp;
-    int32_t red;
-    int32_t grn;
-    int32_t blu;
-
-    yuv_to_rgb(y1, u1, v1, &red, &grn, &blu);
-    tmp = (uint32_t *) trg;
-    tmp[0] = color_tab->gamma_red[256 + red]
-             | color_tab->gamma_grn[256 + grn]
-             | color_tab->gamma_blu[256 + blu]
-             | color_tab->alpha;
-
-    yuv_to_rgb(y2, u2, v2, &red, &grn, &blu);
-    tmp[1] = color_tab->gamma_red[256 + red]
-             | color_tab->gamma_grn[256 + grn]
-             | color_tab->gamma_blu[256 + blu]
-             | color_tab->alpha;
+    const int32_t *red = pl->red;
+    const int32_t *grn = pl->grn;
+    const int32_t *blu = pl->blu;
+    uint32_t *tmp = (uint32_t *)trg;
+    unsigned int x;
+
+    for (x = 0; x < n; x++) {
+        tmp[x] = color_tab->gamma_red[256 + red[x]]
+                 | color_tab->gamma_grn[256 + grn[x]]
+                 | color_tab->gamma_blu[256 + blu[x]]
+                 | color_tab->alpha;
+    }
 }
 
 /* PAL 1x1 renderers */
@@ -101,10 +249,12 @@ render_generic_1x1_pal(video_render_color_tables_t *color_tab, const uint8_t *sr
     const int32_t *ytablel = color_tab->ytablel;
     const int32_t *ytableh = color_tab->ytableh;
     const uint8_t *tmpsrc;
-    uint8_t *tmptrg;
-    unsigned int x, y;
-    int32_t *line, l1, l2, u1, u2, v1, v2, unew, vnew;
-    uint8_t cl0, cl1, cl2, cl3;
+    unsigned int y;
+    /* the delay line is set up again from the line above on every call, so
+       that the frame can be rendered in independent bands */
+    int32_t line_u[VIDEO_MAX_OUTPUT_WIDTH];
+    int32_t line_v[VIDEO_MAX_OUTPUT_WIDTH];
+    pal_line_t pl;
     int off, off_flip;
 
     /* ensure starting on even coords */
@@ -114,10 +264,13 @@ render_generic_1x1_pal(video_render_color_tables_t *color_tab, const uint8_t *sr
         width++;
     }
 
+    if (width > VIDEO_MAX_OUTPUT_WIDTH) {
+        width = VIDEO_MAX_OUTPUT_WIDTH;
+    }
+
     src = src + pitchs * ys + xs - 2;
     trg = trg + pitcht * yt + (xt >> 1) * pixelstride;
 
-    line = color_tab->line_yuv_0;
     tmpsrc = ys > 0 ? src - pitchs : src;
 
     /* is the previous line odd or even? (inverted condition!) */
@@ -130,28 +283,16 @@ render_generic_1x1_pal(video_render_color_tables_t *color_tab, const uint8_t *sr
     }
 
     /* prepare previous (delay-)line */
-    for (x = 0; x < width; x++) {
-        cl0 = tmpsrc[0];
-        cl1 = tmpsrc[1];
-        cl2 = tmpsrc[2];
-        cl3 = tmpsrc[3];
-        tmpsrc += 1;
-        line[0] = (cbtable[cl0] + cbtable[cl1] + cbtable[cl2] + cbtable[cl3]);
-        line[1] = (crtable[cl0] + crtable[cl1] + crtable[cl2] + crtable[cl3]);
-        line += 2;
-    }
+    pal_fetch_line(&pl, tmpsrc, width, cbtable, crtable, ytablel, ytableh);
+    pal_chroma_line(&pl, width, line_u, line_v);
 
-    width >>= 1;
+    /* pixels are written in pairs */
+    width &= ~1U;
 
     /* Calculate odd line shading */
     off = (int) (((float) config->video_resources.pal_oddlines_offset * (1.5f / 2000.0f) - (1.5f / 2.0f - 1.0f)) * (1 << 5));
 
     for (y = ys; y < height + ys; y++) {
-        tmpsrc = src;
-        tmptrg = trg;
-
-        line = color_tab->line_yuv_0;
-
         if (y & 1) { /* odd sourceline */
             off_flip = off;
             cbtable = yuvtarget ? color_tab->cutable_odd : color_tab->cbtable_odd;
@@ -163,45 +304,17 @@ render_generic_1x1_pal(video_render_color_tables_t *color_tab, const uint8_t *sr
         }
 
         /* one scanline */
-        for (x = 0; x < width; x++) {
-            cl0 = tmpsrc[0];
-            cl1 = tmpsrc[1];
-            cl2 = tmpsrc[2];
-            cl3 = tmpsrc[3];
-            tmpsrc += 1;
-            l1 = ytablel[cl1] + ytableh[cl2] + ytablel[cl3];
-            unew = cbtable[cl0] + cbtable[cl1] + cbtable[cl2] + cbtable[cl3];
-            vnew = crtable[cl0] + crtable[cl1] + crtable[cl2] + crtable[cl3];
-            u1 = (unew + line[0]) * off_flip;
-            v1 = (vnew + line[1]) * off_flip;
-            line[0] = unew;
-            line[1] = vnew;
-            line += 2;
-
-            cl0 = tmpsrc[0];
-            cl1 = tmpsrc[1];
-            cl2 = tmpsrc[2];
-            cl3 = tmpsrc[3];
-            tmpsrc += 1;
-            l2 = ytablel[cl1] + ytableh[cl2] + ytablel[cl3];
-            unew = cbtable[cl0] + cbtable[cl1] + cbtable[cl2] + cbtable[cl3];
-            vnew = crtable[cl0] + crtable[cl1] + crtable[cl2] + crtable[cl3];
-            u2 = (unew + line[0]) * off_flip;
-            v2 = (vnew + line[1]) * off_flip;
-            line[0] = unew;
-            line[1] = vnew;
-            line += 2;
+        pal_fetch_line(&pl, src, width, cbtable, crtable, ytablel, ytableh);
+        pal_rgb_line(&pl, width, off_flip, line_u, line_v);
 
 #ifdef __LIBRETRO__
-            if (pix_bytes == 2)
-               store_pixel_2(color_tab, tmptrg, l1, u1, v1, l2, u2, v2);
-            else
-               store_pixel_4(color_tab, tmptrg, l1, u1, v1, l2, u2, v2);
+        if (pix_bytes == 2)
+            store_line_2(color_tab, trg, width, &pl);
+        else
+            store_line_4(color_tab, trg, width, &pl);
 #else
-            store_pixel_4(color_tab, tmptrg, l1, u1, v1, l2, u2, v2);
+        store_line_4(color_tab, trg, width, &pl);
 #endif
-            tmptrg += pixelstride;
-        }
 
         src += pitchs;
         trg += pitcht;
@@ -71,23 +71,12 @@ void video_render_setphysicalcolor(video_render_config_t *config, int index,
 
 static int rendermode_error = -1;
 
-void video_render_main(video_render_config_t *config, uint8_t *src, uint8_t *trg,
-                       int width, int height, int xs, int ys, int xt, int yt,
-                       int pitchs, int pitcht, viewport_t *viewport)
+static void video_render_rect(video_render_config_t *config, uint8_t *src, uint8_t *trg,
+                              int width, int height, int xs, int ys, int xt, int yt,
+                              int pitchs, int pitcht, viewport_t *viewport)
 {
     int rendermode;
 
-#if 0
-    log_debug(LOG_DEFAULT, "w:%i h:%i xs:%i ys:%i xt:%i yt:%i ps:%i pt:%i d%i",
-              width, height, xs, ys, xt, yt, pitchs, pitcht, depth);
-
-#endif
-    if (width <= 0) {
-        return; /* some render routines don't like invalid width */
-    }
-
-    video_sound_update(config, src, width, height, xs, ys, pitchs, viewport);
-
     rendermode = config->rendermode;
 
     switch (rendermode) {
@@ -123,6 +112,145 @@ void video_render_main(video_render_config_t *config, uint8_t *src, uint8_t *trg
     rendermode_error = rendermode;
 }
 
+#if defined(__LIBRETRO__) && defined(HAVE_THREADS)
+#include "rthreads/tpool.h"
+
+/* The frame is cut into at most this many horizontal bands, the calling
+   thread renders the last one itself.  */
+#define VIDEO_RENDER_BANDS_MAX 4
+
+/* Bands shorter than this are not worth waking up the pool for */
+#define VIDEO_RENDER_BAND_MIN_LINES 32
+
+typedef struct video_render_band_s {
+    video_render_config_t *config;
+    uint8_t *src;
+    uint8_t *trg;
+    int width, height, xs, ys, xt, yt, pitchs, pitcht;
+    viewport_t *viewport;
+} video_render_band_t;
+
+static video_render_band_t video_render_bands[VIDEO_RENDER_BANDS_MAX];
+static tpool_t *video_render_pool = NULL;
+static int video_render_threads_enabled = 0;
+
+static void video_render_band_func(void *arg)
+{
+    video_render_band_t *band = (video_render_band_t *)arg;
+
+    video_render_rect(band->config, band->src, band->trg, band->width, band->height,
+                      band->xs, band->ys, band->xt, band->yt, band->pitchs, band->pitcht,
+                      band->viewport);
+}
+
+/* The pool is only created and destroyed here, from the thread running
+   the emulation. Callers must make sure no frame is being rendered
+   elsewhere (see video_pipeline_sync()) while it changes.  */
+void video_render_threads_set(int enable)
+{
+    if (enable && video_render_pool == NULL) {
+        video_render_pool = tpool_create(VIDEO_RENDER_BANDS_MAX - 1);
+    } else if (!enable && video_render_pool != NULL) {
+        tpool_destroy(video_render_pool);
+        video_render_pool = NULL;
+    }
+    video_render_threads_enabled = (video_render_pool != NULL);
+}
+
+/* Only renderers whose lines depend on nothing but the source lines (the
+   1x1 PAL filter sets up its delay line from the line above the band) can
+   be split.  */
+static int video_render_banded(video_render_config_t *config, uint8_t *src, uint8_t *trg,
+                               int width, int height, int xs, int ys, int xt, int yt,
+                               int pitchs, int pitcht, viewport_t *viewport)
+{
+    video_render_band_t *band;
+    int i, num, lines, y;
+
+    if (!video_render_threads_enabled
+        || config->rendermode != VIDEO_RENDER_PAL_NTSC_1X1) {
+        return 0;
+    }
+
+    num = height / VIDEO_RENDER_BAND_MIN_LINES;
+    if (num > VIDEO_RENDER_BANDS_MAX) {
+        num = VIDEO_RENDER_BANDS_MAX;
+    }
+    if (num < 2) {
+        return 0;
+    }
+
+    y = 0;
+    for (i = 0; i < num; i++) {
+        lines = (height - y) / (num - i);
+        band = &video_render_bands[i];
+        band->config = config;
+        band->src = src;
+        band->trg = trg;
+        band->width = width;
+        band->height = lines;
+        band->xs = xs;
+        band->ys = ys + y;
+        band->xt = xt;
+        band->yt = yt + y;
+        band->pitchs = pitchs;
+        band->pitcht = pitcht;
+        band->viewport = viewport;
+        y += lines;
+    }
+
+    for (i = 0; i < num - 1; i++) {
+        if (!tpool_add_work(video_render_pool, video_render_band_func, &video_render_bands[i])) {
+            video_render_band_func(&video_render_bands[i]);
+        }
+    }
+    video_render_band_func(&video_render_bands[num - 1]);
+    tpool_wait(video_render_pool);
+
+    return 1;
+}
+#endif
+
+void video_render_main(video_render_config_t *config, uint8_t *src, uint8_t *trg,
+                       int width, int height, int xs, int ys, int xt, int yt,
+                       int pitchs, int pitcht, viewport_t *viewport)
+{
+#if 0
+    log_debug(LOG_DEFAULT, "w:%i h:%i xs:%i ys:%i xt:%i yt:%i ps:%i pt:%i d%i",
+              width, height, xs, ys, xt, yt, pitchs, pitcht, depth);
+
+#endif
+    if (width <= 0) {
+        return; /* some render routines don't like invalid width */
+    }
+
+    video_sound_update(config, src, width, height, xs, ys, pitchs, viewport);
+
+    video_render_pixels(config, src, trg, width, height, xs, ys, xt, yt,
+                        pitchs, pitcht, viewport);
+}
+
+/* Like video_render_main(), without feeding the video->audio leak. Meant
+   for callers that render away from the emulation thread and do the sound
+   update themselves.  */
+void video_render_pixels(video_render_config_t *config, uint8_t *src, uint8_t *trg,
+                         int width, int height, int xs, int ys, int xt, int yt,
+                         int pitchs, int pitcht, viewport_t *viewport)
+{
+    if (width <= 0) {
+        return;
+    }
+
+#if defined(__LIBRETRO__) && defined(HAVE_THREADS)
+    if (video_render_banded(config, src, trg, width, height, xs, ys, xt, yt,
+                            pitchs, pitcht, viewport)) {
+        return;
+    }
+#endif
+    video_render_rect(config, src, trg, width, height, xs, ys, xt, yt,
+                      pitchs, pitcht, viewport);
+}
+
 void video_render_palntscfunc_set(render_pal_ntsc_func_t func)
 {
     render_pal_ntsc_func = func;
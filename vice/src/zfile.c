@@ -57,6 +57,10 @@
 
 #include "zfile.h"
 
+#ifdef __LIBRETRO__
+#include "memfile.h"
+#endif
+
 
 /* ------------------------------------------------------------------------- */
 
@@ -91,6 +95,9 @@ struct zfile_s {
     struct zfile_s *prev, *next; /* Link to the previous and next nodes.  */
     zfile_action_t action;       /* action on close */
     char *request_string;        /* ui string for action=ZFILE_REQUEST */
+    struct memfile_buffer_s *mem; /* Uncompressed data of a memory stream. */
+    const uint8_t *map;          /* Read-only mapping of the file, if any.  */
+    size_t map_size;
 };
 typedef struct zfile_s zfile_t;
 
@@ -134,6 +141,14 @@ static void zfile_list_destroy(void)
 
         lib_free(p->orig_name);
         lib_free(p->tmp_name);
+        lib_free(p->request_string);
+#ifdef __LIBRETRO__
+        if (p->mem != NULL) {
+            lib_free(p->mem->data);
+            lib_free(p->mem);
+        }
+        memfile_unmap(p->map, p->map_size);
+#endif
         next = p->next;
         lib_free(p);
         p = next;
@@ -160,7 +175,8 @@ static void zfile_list_add(const char *tmp_name,
                            const char *orig_name,
                            enum compression_type type,
                            int write_mode,
-                           FILE *stream, FILE *fd)
+                           FILE *stream, FILE *fd,
+                           struct memfile_buffer_s *mem)
 {
     zfile_t *new_zfile = lib_malloc(sizeof(zfile_t));
 
@@ -175,6 +191,9 @@ static void zfile_list_add(const char *tmp_name,
     new_zfile->type = type;
     new_zfile->action = ZFILE_KEEP;
     new_zfile->request_string = NULL;
+    new_zfile->mem = mem;
+    new_zfile->map = NULL;
+    new_zfile->map_size = 0;
     new_zfile->next = zfile_list;
     new_zfile->prev = NULL;
     if (zfile_list != NULL) {
@@ -192,50 +211,67 @@ void zfile_shutdown(void)
 
 /* Uncompression.  */
 
-/* If `name' has a gzip-like extension, try to uncompress it into a temporary
-   file using gzip or zlib if available.  If this succeeds, return the name
-   of the temporary file; return NULL otherwise.  */
-static char *try_uncompress_with_gzip(const char *name)
+/* If `name' has a gzip-like extension, try to uncompress it into memory
+   using zlib.  If this succeeds, return the uncompressed data and its size
+   in `size'; return NULL otherwise.  */
+static uint8_t *try_uncompress_with_gzip(const char *name, size_t *size)
 {
-    FILE *fddest;
     gzFile fdsrc;
-    char *tmp_name = NULL;
-    int len;
+    uint8_t *data;
+    size_t len = 0, max = 0x10000;
+    int n;
 
     if (!file_is_gzip(name)) {
         return NULL;
     }
 
-    fddest = archdep_mkstemp_fd(&tmp_name, MODE_WRITE);
+    fdsrc = gzopen(name, MODE_READ);
+    if (fdsrc == NULL) {
+        return NULL;
+    }
+
+    data = lib_malloc(max);
+    do {
+        if (len == max) {
+            max *= 2;
+            data = lib_realloc(data, max);
+        }
+        n = gzread(fdsrc, (void *)(data + len), (unsigned int)(max - len));
+        if (n > 0) {
+            len += (size_t)n;
+        }
+    } while (n > 0);
+
+    gzclose(fdsrc);
+
+    if (n < 0) {
+        lib_free(data);
+        return NULL;
+    }
+
+    *size = len;
+    return data;
+}
 
+/* Write `size' bytes of uncompressed data into a temporary file.  Return
+   the name of the temporary file or NULL on failure.  */
+static char *write_tmp_file(const uint8_t *data, size_t size)
+{
+    FILE *fddest;
+    char *tmp_name = NULL;
+
+    fddest = archdep_mkstemp_fd(&tmp_name, MODE_WRITE);
     if (fddest == NULL) {
         return NULL;
     }
 
-    fdsrc = gzopen(name, MODE_READ);
-    if (fdsrc == NULL) {
+    if (size > 0 && fwrite((const void *)data, 1, size, fddest) < size) {
         fclose(fddest);
         archdep_remove(tmp_name);
         lib_free(tmp_name);
         return NULL;
     }
 
-    do {
-        char buf[256];
-
-        len = gzread(fdsrc, (void *)buf, 256);
-        if (len > 0) {
-            if (fwrite((void *)buf, 1, (size_t)len, fddest) < len) {
-                gzclose(fdsrc);
-                fclose(fddest);
-                archdep_remove(tmp_name);
-                lib_free(tmp_name);
-                return NULL;
-            }
-        }
-    } while (len > 0);
-
-    gzclose(fdsrc);
     fclose(fddest);
 
     return tmp_name;
@@ -744,13 +780,18 @@ static const valid_archives_t valid_archives[] = {
    temporary file, return the type of algorithm used and the name of the
    temporary file in `tmp_name'.  If `write_mode' is non-zero and the
    returned `tmp_name' has zero length, then the file cannot be accessed in
-   write mode.  */
+   write mode.  Algorithms that can uncompress into memory return the data
+   in `mem' and its size in `mem_size' instead, with `tmp_name' NULL.  */
 static enum compression_type try_uncompress(const char *name,
                                             char **tmp_name,
-                                            int write_mode)
+                                            int write_mode,
+                                            uint8_t **mem,
+                                            size_t *mem_size)
 {
     int i;
 
+    *mem = NULL;
+
     for (i = 0; valid_archives[i].program; i++) {
         if ((*tmp_name = try_uncompress_archive(name, write_mode,
                                                 valid_archives[i].program,
@@ -764,7 +805,8 @@ static enum compression_type try_uncompress(const char *name,
     }
 
     /* need this order or .tar.gz is misunderstood */
-    if ((*tmp_name = try_uncompress_with_gzip(name)) != NULL) {
+    if ((*mem = try_uncompress_with_gzip(name, mem_size)) != NULL) {
+        *tmp_name = NULL;
         return COMPR_GZIP;
     }
 
@@ -953,6 +995,68 @@ static int zfile_compress(const char *src, const char *dest,
     }
     return retval;
 }
+#else /* __LIBRETRO__ */
+/* Compression.  */
+
+/* Compress `size' bytes at `data' into `dest' using gzip.  The original is
+   kept as a backup until the new file is complete.  */
+static int zfile_compress_mem(const uint8_t *data, size_t size,
+                              const char *dest)
+{
+    char *dest_backup_name;
+    gzFile fddest;
+    size_t pos;
+    unsigned int len;
+    int retval = 0;
+
+    /* If we have no write permissions for `dest', give up.  */
+    if (archdep_access(dest, ARCHDEP_ACCESS_W_OK) < 0) {
+        ZDEBUG(("compress: no write permissions for `%s'", dest));
+        return -1;
+    }
+
+    dest_backup_name = archdep_make_backup_filename(dest);
+    if (dest_backup_name != NULL
+        && archdep_rename(dest, dest_backup_name) < 0) {
+        log_error(zlog, "Could not make pre-compression backup.");
+        lib_free(dest_backup_name);
+        return -1;
+    }
+
+    fddest = gzopen(dest, MODE_WRITE "9");
+    if (fddest == NULL) {
+        retval = -1;
+    } else {
+        for (pos = 0; pos < size; pos += len) {
+            len = (unsigned int)((size - pos) < 0x10000 ? (size - pos) : 0x10000);
+            if (gzwrite(fddest, (voidpc)(data + pos), len) != (int)len) {
+                retval = -1;
+                break;
+            }
+        }
+        if (gzclose(fddest) != Z_OK) {
+            retval = -1;
+        }
+    }
+
+    if (retval == -1) {
+        /* Compression failed: restore original file.  */
+        if (dest_backup_name != NULL
+            && archdep_rename(dest_backup_name, dest) < 0) {
+            log_error(zlog,
+                      "Could not restore backup file after failed compression.");
+        }
+    } else {
+        /* Compression succeeded: remove backup file.  */
+        if (dest_backup_name != NULL
+            && archdep_remove(dest_backup_name) < 0) {
+            log_error(zlog, "Warning: could not remove backup file.");
+        }
+    }
+
+    lib_free(dest_backup_name);
+    return retval;
+}
 #endif /* __LIBRETRO__ */
 /* ------------------------------------------------------------------------ */
 
@@ -972,6 +1076,8 @@ FILE *zfile_fopen(const char *name, const char *mode)
     FILE *stream;
     enum compression_type type;
     int write_mode = 0;
+    uint8_t *mem;
+    size_t mem_size = 0;
 
     if (!zinit_done) {
         zinit();
@@ -991,14 +1097,35 @@ FILE *zfile_fopen(const char *name, const char *mode)
         return NULL;
     }
 
-    type = try_uncompress(name, &tmp_name, write_mode);
+    type = try_uncompress(name, &tmp_name, write_mode, &mem, &mem_size);
     if (type == COMPR_NONE) {
         stream = fopen(name, mode);
         if (stream == NULL) {
             return NULL;
         }
-        zfile_list_add(NULL, name, type, write_mode, stream, NULL);
+        zfile_list_add(NULL, name, type, write_mode, stream, NULL, NULL);
         return stream;
+    } else if (mem != NULL) {
+#ifdef __LIBRETRO__
+        /* Attach the uncompressed data straight from memory.  Writes stay in
+           the buffer, which grows as needed (D64 extended to 40 tracks, G64
+           tracks appended), and are compressed back on close.  */
+        memfile_buffer_t *buf = lib_calloc(1, sizeof(memfile_buffer_t));
+
+        buf->data = mem;
+        buf->size = buf->alloc = mem_size;
+        stream = memfile_open(buf, mode);
+        if (stream != NULL) {
+            zfile_list_add(NULL, name, type, write_mode, stream, NULL, buf);
+            return stream;
+        }
+        lib_free(buf);
+#endif
+        tmp_name = write_tmp_file(mem, mem_size);
+        lib_free(mem);
+        if (tmp_name == NULL) {
+            return NULL;
+        }
     } else if (*tmp_name == '\0') {
         errno = EACCES;
         return NULL;
@@ -1010,7 +1137,7 @@ FILE *zfile_fopen(const char *name, const char *mode)
         return NULL;
     }
 
-    zfile_list_add(tmp_name, name, type, write_mode, stream, NULL);
+    zfile_list_add(tmp_name, name, type, write_mode, stream, NULL, NULL);
 
     /* now we don't need the archdep_tmpnam allocation any more */
     lib_free(tmp_name);
@@ -1046,6 +1173,7 @@ static int handle_close_action(zfile_t *ptr)
 /* Handle close of a (compressed file). `ptr' points to the zfile to close.  */
 static int handle_close(zfile_t *ptr)
 {
+    int retval = 0;
     ZDEBUG(("handle_close: closing `%s' (`%s'), write_mode = %d",
             ptr->tmp_name ? ptr->tmp_name : "(null)",
             ptr->orig_name, ptr->write_mode));
@@ -1065,6 +1193,18 @@ static int handle_close(zfile_t *ptr)
         }
     }
 
+#ifdef __LIBRETRO__
+    /* Store what was written to a memory stream.  */
+    if (ptr->mem
+        && ptr->orig_name
+        && ptr->write_mode
+        && ptr->mem->dirty
+        && zfile_compress_mem(ptr->mem->data, ptr->mem->size, ptr->orig_name) < 0) {
+        log_error(zlog, "Cannot write back `%s'.", ptr->orig_name);
+        retval = -1;
+    }
+#endif
+
     handle_close_action(ptr);
 
     /* Remove item from list.  */
@@ -1087,10 +1227,17 @@ static int handle_close(zfile_t *ptr)
     if (ptr->request_string) {
         lib_free(ptr->request_string);
     }
+#ifdef __LIBRETRO__
+    if (ptr->mem) {
+        lib_free(ptr->mem->data);
+        lib_free(ptr->mem);
+    }
+    memfile_unmap(ptr->map, ptr->map_size);
+#endif
 
     lib_free(ptr);
 
-    return 0;
+    return retval;
 }
 
 /* `fclose()' wrapper.  */
@@ -1122,6 +1269,42 @@ int zfile_fclose(FILE *stream)
     return fclose(stream);
 }
 
+/* Read-only view of everything behind `stream', for callers that would
+   rather index the data than seek and read. Decompressed data is handed out
+   straight from its buffer, but only for read-only streams since writes may
+   move the buffer. Plain files are mapped, also only when opened read-only
+   since writes through the stream would not show up in the mapping. The view
+   stays valid until the stream is closed. Returns NULL if there is none.  */
+const uint8_t *zfile_map(FILE *stream, size_t *size)
+{
+    zfile_t *ptr;
+
+    for (ptr = zfile_list; ptr != NULL; ptr = ptr->next) {
+        if (ptr->stream == stream) {
+            break;
+        }
+    }
+    if (ptr == NULL) {
+        return NULL;
+    }
+
+#ifdef __LIBRETRO__
+    if (ptr->mem != NULL) {
+        if (ptr->write_mode) {
+            return NULL;
+        }
+        *size = ptr->mem->size;
+        return ptr->mem->data;
+    }
+
+    if (ptr->map == NULL && ptr->type == COMPR_NONE && !ptr->write_mode) {
+        ptr->map = memfile_map(ptr->orig_name, &ptr->map_size);
+    }
+#endif
+    *size = ptr->map_size;
+    return ptr->map;
+}
+
 int zfile_close_action(const char *filename, zfile_action_t action,
                        const char *request_str)
 {
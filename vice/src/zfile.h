@@ -30,6 +30,8 @@
 
 #include <stdio.h>
 
+#include "types.h"
+
 /* actions to be done when a zfile is closed */
 typedef enum {
     ZFILE_KEEP,         /* Nothing, keep original file (default).  */
@@ -39,6 +41,7 @@ typedef enum {
 
 FILE *zfile_fopen(const char *name, const char *mode);
 int zfile_fclose(FILE *stream);
+const uint8_t *zfile_map(FILE *stream, size_t *size);
 
 void zfile_shutdown(void);
 